@@ -0,0 +1,49 @@
+# Copyright (C) 2018  Christian Berger
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+###########################################################################
+# Find libjpeg-turbo's TurboJPEG API.
+FIND_PATH(TURBOJPEG_INCLUDE_DIR
+          NAMES turbojpeg.h
+          PATHS /usr/local/include/
+                /usr/include/)
+MARK_AS_ADVANCED(TURBOJPEG_INCLUDE_DIR)
+FIND_LIBRARY(TURBOJPEG_LIBRARY
+             NAMES turbojpeg
+             PATHS ${TURBOJPEGDIR}/lib/
+                    /usr/lib/arm-linux-gnueabihf/
+                    /usr/lib/arm-linux-gnueabi/
+                    /usr/lib/x86_64-linux-gnu/
+                    /usr/local/lib64/
+                    /usr/lib64/
+                    /usr/lib/)
+MARK_AS_ADVANCED(TURBOJPEG_LIBRARY)
+
+###########################################################################
+IF (TURBOJPEG_INCLUDE_DIR
+    AND TURBOJPEG_LIBRARY)
+    SET(TURBOJPEG_FOUND 1)
+    SET(TURBOJPEG_LIBRARIES ${TURBOJPEG_LIBRARY})
+    SET(TURBOJPEG_INCLUDE_DIRS ${TURBOJPEG_INCLUDE_DIR})
+ENDIF()
+
+MARK_AS_ADVANCED(TURBOJPEG_LIBRARIES)
+MARK_AS_ADVANCED(TURBOJPEG_INCLUDE_DIRS)
+
+IF (TURBOJPEG_FOUND)
+    MESSAGE(STATUS "Found TurboJPEG: ${TURBOJPEG_INCLUDE_DIRS}, ${TURBOJPEG_LIBRARIES}")
+ELSE ()
+    MESSAGE(STATUS "Could not find TurboJPEG; using OpenCV to compress JPEG frames")
+ENDIF()
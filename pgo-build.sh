@@ -0,0 +1,59 @@
+#!/bin/sh
+
+# Copyright (C) 2018  Christian Berger
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Experimental profile-guided and link-time optimized build (cf. README.md): the
+# binaries are built with instrumentation, trained with the synthetic camera and
+# the benchmark, and rebuilt in the same build folder (the profiles are named
+# after the object files) from the collected profiles with LTO.
+#
+# Usage: pgo-build.sh <build folder> [further arguments for cmake]
+# Example: ./pgo-build.sh build -D CMAKE_BUILD_TYPE=Release && make -C build install
+#
+# TRAINING_SECONDS (default 20) sets how long each synthetic camera runs.
+
+set -e
+
+if [ -z "$1" ]; then
+    echo "Usage: $0 <build folder> [further arguments for cmake]" >&2
+    exit 1
+fi
+SOURCES=$(cd "$(dirname "$0")" && pwd)
+BUILD=$1
+shift
+TRAINING_SECONDS=${TRAINING_SECONDS:-20}
+PROFILES=$(mkdir -p "$BUILD" && cd "$BUILD" && pwd)/pgo-profiles
+
+echo "[pgo-build]: Building instrumented binaries."
+rm -rf "$PROFILES"
+cmake -S "$SOURCES" -B "$BUILD" "$@" -D PGO=GENERATE -D PGO_PROFILE_DIR="$PROFILES"
+cmake --build "$BUILD" -- -j"$(nproc)"
+
+# The microservice is trained like it runs in production: both capture formats
+# with the software auto-exposure at a frame rate above the usual ones, each
+# terminated via SIGINT so that the profiles are written on a regular exit.
+echo "[pgo-build]: Training with the synthetic camera."
+for FORMAT in "" "--yuyv422"; do
+    timeout -s INT "$TRAINING_SECONDS" "$BUILD/opendlv-device-camera-opencv" --camera=synthetic --width=1280 --height=720 --freq=60 \
+        --name.i420=pgo-build.$$.i420 --name.argb=pgo-build.$$.argb --auto-exposure $FORMAT || [ $? -eq 124 ]
+done
+
+echo "[pgo-build]: Training with the benchmark."
+"$BUILD/opendlv-device-camera-opencv-benchmark" --iterations=50 --out="$BUILD/pgo-training.json"
+
+echo "[pgo-build]: Rebuilding with the collected profiles and LTO."
+cmake -S "$SOURCES" -B "$BUILD" "$@" -D PGO=USE -D PGO_PROFILE_DIR="$PROFILES"
+cmake --build "$BUILD" --clean-first -- -j"$(nproc)"
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUTO_EXPOSURE_HPP
+#define AUTO_EXPOSURE_HPP
+
+#include "camera-control.hpp"
+#include "luma-histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * AutoExposure drives exposure and gain of a camera toward a target mean luma
+ * while keeping the fraction of saturated pixels below a limit. Exposure is
+ * preferred over gain as it does not amplify noise: brightening first raises
+ * the exposure up to its maximum before raising the gain, and darkening first
+ * lowers the gain before lowering the exposure.
+ *
+ * The resulting settings are requested via CameraControl and hence, applied
+ * by the capturing thread between two frames; once CameraControl received a
+ * manual request for exposure or gain, no further settings are requested.
+ */
+class AutoExposure {
+   private:
+    AutoExposure(const AutoExposure &) = delete;
+    AutoExposure(AutoExposure &&)      = delete;
+    AutoExposure &operator=(const AutoExposure &) = delete;
+    AutoExposure &operator=(AutoExposure &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param targetMean Desired mean luma (0..255).
+     * @param maxClippedBright Maximum fraction of samples at or above LUMA_CLIPPED_BRIGHT.
+     * @param exposure Current exposure in camera units.
+     * @param minExposure Minimum exposure in camera units.
+     * @param maxExposure Maximum exposure in camera units.
+     * @param gain Current gain in camera units.
+     * @param minGain Minimum gain in camera units.
+     * @param maxGain Maximum gain in camera units.
+     */
+    AutoExposure(float targetMean, float maxClippedBright, float exposure, float minExposure, float maxExposure, float gain, float minGain, float maxGain) noexcept
+        : m_targetMean(targetMean)
+        , m_maxClippedBright(maxClippedBright)
+        , m_minExposure(minExposure)
+        , m_maxExposure(std::max(minExposure, maxExposure))
+        , m_minGain(minGain)
+        , m_maxGain(std::max(minGain, maxGain))
+        , m_exposure(std::min(std::max(exposure, m_minExposure), m_maxExposure))
+        , m_gain(std::min(std::max(gain, m_minGain), m_maxGain))
+        , m_framesSinceLastChange(0) {}
+
+    /**
+     * This method evaluates the statistics of the latest frame and requests
+     * new settings from cameraControl if necessary.
+     *
+     * @return true if new settings were requested.
+     */
+    bool update(const LumaStatistics &statistics, CameraControl &cameraControl) noexcept {
+        // Changes take effect a few frames later; wait for them to avoid oscillation.
+        constexpr uint32_t SETTLING_FRAMES{3};
+        // Deviation from the target mean that is tolerated.
+        constexpr float DEADBAND{8.0f};
+        // Maximum change per step.
+        constexpr float MAX_STEP{2.0f};
+
+        if (!cameraControl.isAutoExposureActive()) {
+            return false;
+        }
+
+        m_framesSinceLastChange++;
+        if ( (0 == statistics.samples) || (m_framesSinceLastChange < SETTLING_FRAMES) ) {
+            return false;
+        }
+
+        const bool TOO_BRIGHT{statistics.clippedBright > m_maxClippedBright};
+        if (!TOO_BRIGHT && (std::fabs(statistics.mean - m_targetMean) < DEADBAND)) {
+            return false;
+        }
+
+        // Brightness is roughly proportional to exposure times gain; move halfway
+        // toward the desired ratio and always darken when too many pixels clip.
+        float ratio{m_targetMean / std::max(statistics.mean, 1.0f)};
+        ratio = std::min(std::max(ratio, 1.0f / MAX_STEP), MAX_STEP);
+        ratio = 1.0f + 0.5f * (ratio - 1.0f);
+        if (TOO_BRIGHT) {
+            ratio = std::min(ratio, 0.8f);
+        }
+
+        // Gains may start at 0; treat them as at least 1 to allow for relative changes.
+        float exposure{m_exposure};
+        float gain{std::max(m_gain, 1.0f)};
+        if (ratio > 1.0f) {
+            const float NEW_EXPOSURE{std::min(exposure * ratio, m_maxExposure)};
+            const float REMAINING{ratio * exposure / std::max(NEW_EXPOSURE, 1.0f)};
+            exposure = NEW_EXPOSURE;
+            gain = std::min(gain * std::max(REMAINING, 1.0f), m_maxGain);
+        }
+        else {
+            const float NEW_GAIN{std::max(gain * ratio, std::max(m_minGain, 1.0f))};
+            const float REMAINING{ratio * gain / std::max(NEW_GAIN, 1.0f)};
+            gain = NEW_GAIN;
+            exposure = std::max(exposure * std::min(REMAINING, 1.0f), m_minExposure);
+        }
+
+        // Ignore changes below 1% that a camera would not resolve anyway.
+        auto changed = [](float value, float previous) { return std::fabs(value - previous) > 0.01f * std::max(previous, 1.0f); };
+        bool retVal{false};
+        if (changed(exposure, m_exposure)) {
+            m_exposure = exposure;
+            retVal = cameraControl.requestExposureByAutoExposure(m_exposure);
+        }
+        if (changed(gain, m_gain)) {
+            m_gain = gain;
+            retVal = cameraControl.requestGainByAutoExposure(m_gain) || retVal;
+        }
+        if (retVal) {
+            m_framesSinceLastChange = 0;
+        }
+        return retVal;
+    }
+
+    /**
+     * This method changes the maximum exposure, e.g., after the frame rate was
+     * changed, and lowers the exposure if it exceeds the new maximum.
+     *
+     * @return true if a new exposure was requested.
+     */
+    bool setMaxExposure(float maxExposure, CameraControl &cameraControl) noexcept {
+        m_maxExposure = std::max(m_minExposure, maxExposure);
+        if (m_exposure > m_maxExposure) {
+            m_exposure = m_maxExposure;
+            m_framesSinceLastChange = 0;
+            return cameraControl.requestExposureByAutoExposure(m_exposure);
+        }
+        return false;
+    }
+
+    float exposure() const noexcept {
+        return m_exposure;
+    }
+
+    float gain() const noexcept {
+        return m_gain;
+    }
+
+   private:
+    const float m_targetMean;
+    const float m_maxClippedBright;
+    const float m_minExposure;
+    float m_maxExposure;
+    const float m_minGain;
+    const float m_maxGain;
+    float m_exposure;
+    float m_gain;
+    uint32_t m_framesSinceLastChange;
+};
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAMERA_CONTROL_HPP
+#define CAMERA_CONTROL_HPP
+
+#include "frame-source.hpp"
+
+#include <opencv2/videoio/videoio.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+
+/**
+ * CameraControl collects control requests (e.g., received via OD4) from any
+ * thread and applies them to the camera from the capturing thread between
+ * two frames so that the stream is never interrupted. When several requests
+ * for the same control arrive between two frames, only the latest one is
+ * applied. Applied settings are remembered to restore them when the camera
+ * was re-opened.
+ *
+ * Exposure and gain can be handed over to the software auto-exposure; the
+ * first manual request for either of them ends the software auto-exposure
+ * so that it does not overwrite the manual setting with its next step.
+ */
+class CameraControl {
+   private:
+    CameraControl(const CameraControl &) = delete;
+    CameraControl(CameraControl &&)      = delete;
+    CameraControl &operator=(const CameraControl &) = delete;
+    CameraControl &operator=(CameraControl &&) = delete;
+
+    // Automatic modes are listed before their manual values as drivers
+    // ignore manual values while the corresponding automatic mode is active.
+    enum Control : uint32_t {
+        AUTO_EXPOSURE = 0,
+        EXPOSURE,
+        GAIN,
+        AUTO_WHITE_BALANCE,
+        WHITE_BALANCE_TEMPERATURE,
+        FRAME_RATE,
+        NUMBER_OF_CONTROLS
+    };
+
+    struct Request {
+        bool pending{false};
+        double value{0};
+    };
+
+   public:
+    CameraControl() = default;
+
+    void requestExposure(bool automatic, float exposure) noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        endAutoExposure("exposure");
+        setExposure(automatic, exposure);
+    }
+
+    void requestGain(float gain) noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        endAutoExposure("gain");
+        set(GAIN, static_cast<double>(gain));
+    }
+
+    /**
+     * This method hands exposure and gain over to the software auto-exposure
+     * unless either of them was requested manually before.
+     *
+     * @return true if the software auto-exposure is active.
+     */
+    bool startAutoExposure() noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        m_isAutoExposureActive.store(!m_hasManualExposure, std::memory_order_release);
+        return !m_hasManualExposure;
+    }
+
+    /**
+     * @return true while the software auto-exposure controls exposure and gain.
+     */
+    bool isAutoExposureActive() const noexcept {
+        return m_isAutoExposureActive.load(std::memory_order_acquire);
+    }
+
+    /**
+     * This method requests an exposure on behalf of the software auto-exposure.
+     *
+     * @return false if the request was ignored as the software auto-exposure is not active.
+     */
+    bool requestExposureByAutoExposure(float exposure) noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        if (!m_isAutoExposureActive.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        setExposure(false, exposure);
+        return true;
+    }
+
+    /**
+     * This method requests a gain on behalf of the software auto-exposure.
+     *
+     * @return false if the request was ignored as the software auto-exposure is not active.
+     */
+    bool requestGainByAutoExposure(float gain) noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        if (!m_isAutoExposureActive.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        set(GAIN, static_cast<double>(gain));
+        return true;
+    }
+
+    void requestWhiteBalance(bool automatic, float temperature) noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        set(AUTO_WHITE_BALANCE, automatic ? 1.0 : 0.0);
+        if (!automatic) {
+            set(WHITE_BALANCE_TEMPERATURE, static_cast<double>(temperature));
+        }
+    }
+
+    void requestFrameRate(float frameRate) noexcept {
+        if (!(frameRate > 0.0f)) {
+            std::cerr << "[opendlv-device-camera-opencv]: Ignoring request for frame rate " << frameRate << "." << std::endl;
+            return;
+        }
+        std::lock_guard<std::mutex> lck(m_mutex);
+        set(FRAME_RATE, static_cast<double>(frameRate));
+    }
+
+    /**
+     * @param defaultFrameRate Frame rate to return if none was applied yet.
+     * @return Frame rate that was applied last.
+     */
+    float frameRate(float defaultFrameRate) const noexcept {
+        const float APPLIED{m_frameRate.load(std::memory_order_acquire)};
+        return (APPLIED > 0.0f) ? APPLIED : defaultFrameRate;
+    }
+
+    /**
+     * @return true if there are requests that were not yet applied.
+     */
+    bool hasPendingRequests() const noexcept {
+        return m_hasPendingRequests.load(std::memory_order_acquire);
+    }
+
+    /**
+     * This method requests all settings that were applied so far again, e.g.,
+     * after the camera was re-opened.
+     */
+    void restore() noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        for (uint32_t control{0}; control < NUMBER_OF_CONTROLS; control++) {
+            if (m_applied[control].pending && !m_requests[control].pending) {
+                set(static_cast<Control>(control), m_applied[control].value);
+            }
+        }
+    }
+
+    /**
+     * This method applies all pending requests to the given camera; it must be
+     * called from the thread that reads frames from source.
+     *
+     * @return true if all pending requests were accepted by the camera.
+     */
+    bool apply(FrameSource &source) noexcept {
+        std::array<Request, NUMBER_OF_CONTROLS> requests;
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            requests = m_requests;
+            m_requests.fill(Request{});
+            m_hasPendingRequests.store(false, std::memory_order_release);
+        }
+
+        bool retVal{true};
+        for (uint32_t control{0}; control < NUMBER_OF_CONTROLS; control++) {
+            if (requests[control].pending) {
+                const int PROPERTY{property(static_cast<Control>(control))};
+                if (source.set(PROPERTY, requests[control].value)) {
+                    std::lock_guard<std::mutex> lck(m_mutex);
+                    m_applied[control] = requests[control];
+                    if (FRAME_RATE == control) {
+                        m_frameRate.store(static_cast<float>(requests[control].value), std::memory_order_release);
+                    }
+                    std::clog << "[opendlv-device-camera-opencv]: Set " << name(static_cast<Control>(control)) << " to " << requests[control].value << " (camera reports " << source.get(PROPERTY) << ")." << std::endl;
+                }
+                else {
+                    std::cerr << "[opendlv-device-camera-opencv]: Camera does not accept " << name(static_cast<Control>(control)) << " = " << requests[control].value << "." << std::endl;
+                    retVal = false;
+                }
+            }
+        }
+        return retVal;
+    }
+
+   private:
+    void setExposure(bool automatic, float exposure) noexcept {
+        // V4L2_EXPOSURE_APERTURE_PRIORITY (3) or V4L2_EXPOSURE_MANUAL (1) as OpenCV's V4L2 backend passes it through.
+        set(AUTO_EXPOSURE, automatic ? 3.0 : 1.0);
+        if (!automatic) {
+            set(EXPOSURE, static_cast<double>(exposure));
+        }
+    }
+
+    void endAutoExposure(const char *control) noexcept {
+        m_hasManualExposure = true;
+        if (m_isAutoExposureActive.load(std::memory_order_relaxed)) {
+            m_isAutoExposureActive.store(false, std::memory_order_release);
+            std::clog << "[opendlv-device-camera-opencv]: Manual " << control << " request ends the software auto-exposure." << std::endl;
+        }
+    }
+
+    void set(Control control, double value) noexcept {
+        m_requests[control].pending = true;
+        m_requests[control].value = value;
+        m_hasPendingRequests.store(true, std::memory_order_release);
+    }
+
+    static int property(Control control) noexcept {
+        switch (control) {
+            case AUTO_EXPOSURE: return cv::CAP_PROP_AUTO_EXPOSURE;
+            case EXPOSURE: return cv::CAP_PROP_EXPOSURE;
+            case GAIN: return cv::CAP_PROP_GAIN;
+            case AUTO_WHITE_BALANCE: return cv::CAP_PROP_AUTO_WB;
+            case WHITE_BALANCE_TEMPERATURE: return cv::CAP_PROP_WB_TEMPERATURE;
+            case FRAME_RATE: return cv::CAP_PROP_FPS;
+            case NUMBER_OF_CONTROLS: break;
+        }
+        return -1;
+    }
+
+    static const char *name(Control control) noexcept {
+        switch (control) {
+            case AUTO_EXPOSURE: return "auto exposure";
+            case EXPOSURE: return "exposure";
+            case GAIN: return "gain";
+            case AUTO_WHITE_BALANCE: return "auto white balance";
+            case WHITE_BALANCE_TEMPERATURE: return "white balance temperature";
+            case FRAME_RATE: return "frame rate";
+            case NUMBER_OF_CONTROLS: break;
+        }
+        return "unknown control";
+    }
+
+   private:
+    std::mutex m_mutex{};
+    std::array<Request, NUMBER_OF_CONTROLS> m_requests{};
+    std::array<Request, NUMBER_OF_CONTROLS> m_applied{};
+    std::atomic<bool> m_hasPendingRequests{false};
+    bool m_hasManualExposure{false};
+    std::atomic<bool> m_isAutoExposureActive{false};
+    std::atomic<float> m_frameRate{0.0f};
+};
+
+#endif
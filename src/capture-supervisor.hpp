@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_SUPERVISOR_HPP
+#define CAPTURE_SUPERVISOR_HPP
+
+#include "frame-source.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+/**
+ * CaptureSupervisor reads frames from a FrameSource and recovers from
+ * failures: when no frame was delivered within the frame deadline, the source
+ * is released and re-opened with exponential backoff until it delivers frames
+ * again. Everything else, in particular the shared memory areas, stays alive.
+ * The first frame after a gap longer than the deadline is marked as
+ * discontinuity. The deadline applies only once the source delivered its
+ * first frame, so that a camera that is slow to start is neither re-opened
+ * nor reported as recovered.
+ */
+class CaptureSupervisor {
+   private:
+    CaptureSupervisor(const CaptureSupervisor &) = delete;
+    CaptureSupervisor(CaptureSupervisor &&)      = delete;
+    CaptureSupervisor &operator=(const CaptureSupervisor &) = delete;
+    CaptureSupervisor &operator=(CaptureSupervisor &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param source FrameSource to supervise.
+     * @param deadline Maximum time between two frames before the source is re-opened.
+     * @param minBackoff Waiting time after the first failed attempt to re-open the source.
+     * @param maxBackoff Maximum waiting time between two attempts to re-open the source.
+     */
+    CaptureSupervisor(FrameSource &source, std::chrono::milliseconds deadline, std::chrono::milliseconds minBackoff, std::chrono::milliseconds maxBackoff) noexcept
+        : m_source(source)
+        , m_deadline(deadline)
+        , m_minBackoff(minBackoff)
+        , m_maxBackoff(maxBackoff)
+        , m_backoff(minBackoff)
+        , m_lastFrame(std::chrono::steady_clock::now())
+        , m_nextAttempt(m_lastFrame)
+        , m_hasFrame(false)
+        , m_isRecovering(false)
+        , m_recoveries(0)
+        , m_lastRecoveryTime(0) {}
+
+    /**
+     * This method reads the next frame into image; it returns at least every
+     * 100ms to allow the caller to check for termination.
+     *
+     * @param image Frame to read into.
+     * @param discontinuity Set to true if frames were missed before this frame.
+     * @return true if a frame was read.
+     */
+    bool read(cv::Mat &image, bool &discontinuity) noexcept {
+        using namespace std::literals::chrono_literals;
+        discontinuity = false;
+        auto now = std::chrono::steady_clock::now();
+
+        if (!m_source.isOpened()) {
+            if (now < m_nextAttempt) {
+                std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(m_nextAttempt - now, 100ms));
+                return false;
+            }
+            if (!m_source.open()) {
+                m_nextAttempt = std::chrono::steady_clock::now() + m_backoff;
+                m_backoff = std::min(m_backoff * 2, m_maxBackoff);
+                return false;
+            }
+            std::clog << "[opendlv-device-camera-opencv]: Re-opened camera." << std::endl;
+            m_backoff = m_minBackoff;
+        }
+
+        if (m_source.read(image)) {
+            now = std::chrono::steady_clock::now();
+            if (m_hasFrame && (m_isRecovering || (now - m_lastFrame > m_deadline))) {
+                m_lastRecoveryTime = std::chrono::duration_cast<std::chrono::microseconds>(now - m_lastFrame);
+                std::clog << "[opendlv-device-camera-opencv]: Camera delivers frames again after " << m_lastRecoveryTime.count() / 1000 << " ms." << std::endl;
+                m_recoveries++;
+                m_isRecovering = false;
+                discontinuity = true;
+            }
+            m_hasFrame = true;
+            m_lastFrame = now;
+            return true;
+        }
+
+        now = std::chrono::steady_clock::now();
+        if (m_hasFrame && !m_isRecovering && (now - m_lastFrame > m_deadline)) {
+            std::cerr << "[opendlv-device-camera-opencv]: No frame from camera within " << m_deadline.count() << " ms; re-opening." << std::endl;
+            m_isRecovering = true;
+        }
+        if (m_isRecovering) {
+            m_source.release();
+            m_nextAttempt = now;
+        }
+        else {
+            // Avoid spinning on a source that fails right away.
+            std::this_thread::sleep_for(1ms);
+        }
+        return false;
+    }
+
+    /**
+     * This method changes the frame deadline, e.g., after the frame rate was
+     * changed.
+     */
+    void setDeadline(std::chrono::milliseconds deadline) noexcept {
+        if (deadline != m_deadline) {
+            m_deadline = deadline;
+            std::clog << "[opendlv-device-camera-opencv]: Frame deadline changed to " << m_deadline.count() << " ms." << std::endl;
+        }
+    }
+
+    /**
+     * @return Number of recoveries so far.
+     */
+    uint32_t recoveries() const noexcept {
+        return m_recoveries;
+    }
+
+    /**
+     * @return Time without frames before the last recovery.
+     */
+    std::chrono::microseconds lastRecoveryTime() const noexcept {
+        return m_lastRecoveryTime;
+    }
+
+   private:
+    FrameSource &m_source;
+    std::chrono::milliseconds m_deadline;
+    const std::chrono::milliseconds m_minBackoff;
+    const std::chrono::milliseconds m_maxBackoff;
+    std::chrono::milliseconds m_backoff;
+    std::chrono::steady_clock::time_point m_lastFrame;
+    std::chrono::steady_clock::time_point m_nextAttempt;
+    bool m_hasFrame;
+    bool m_isRecovering;
+    uint32_t m_recoveries;
+    std::chrono::microseconds m_lastRecoveryTime;
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLOUR_CORRECTION_HPP
+#define COLOUR_CORRECTION_HPP
+
+#include "frame-layout.hpp"
+
+#include <libyuv.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/**
+ * ColourCorrection applies a camera's calibration to the ARGB frames: a 3x3
+ * colour correction matrix (CCM) followed by a 1D lookup table (LUT) per
+ * channel, e.g., a gamma curve. I420 frames are published as captured.
+ *
+ * The calibration is read from a text file with one entry per line; '#'
+ * starts a comment:
+ *
+ *   ccm <rr> <rg> <rb>     three lines with the rows of the CCM producing
+ *   ccm <gr> <gg> <gb>     R, G, and B from the captured R, G, and B
+ *   ccm <br> <bg> <bb>
+ *   gamma <value>          LUT 255 * (v / 255)^(1 / value) for all channels, or
+ *   lut <r> <g> <b>        256 lines with the output for the inputs 0 to 255
+ *
+ * A missing CCM or LUT means identity. Both are converted once into libyuv's
+ * fixed-point tables: the CCM into signed 6 bit fractions, i.e., coefficients
+ * from -2 to 1.984 in steps of 1/64, and the LUTs into one interleaved table.
+ * They are applied to bands of rows right after converting them to ARGB while
+ * the band is still in the cache, i.e., without another pass over the frame.
+ */
+class ColourCorrection {
+   private:
+    ColourCorrection(const ColourCorrection &) = delete;
+    ColourCorrection(ColourCorrection &&)      = delete;
+    ColourCorrection &operator=(const ColourCorrection &) = delete;
+    ColourCorrection &operator=(ColourCorrection &&) = delete;
+
+    // 16 rows of 1920 ARGB pixels are 120 kB and still fit into the L2 cache.
+    static constexpr uint32_t BAND_HEIGHT{16};
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param filename File with the calibration.
+     */
+    explicit ColourCorrection(const std::string &filename) noexcept
+        : m_matrix{}
+        , m_table{}
+        , m_hasMatrix(false)
+        , m_hasTable(false)
+        , m_valid(false) {
+        std::ifstream file(filename);
+        if (!file.good()) {
+            std::cerr << "[opendlv-device-camera-opencv]: Could not open colour correction '" << filename << "'." << std::endl;
+            return;
+        }
+        m_valid = load(file, filename);
+    }
+
+    /**
+     * Constructor.
+     *
+     * @param calibration Stream with the calibration.
+     * @param name Name of the calibration for error messages.
+     */
+    ColourCorrection(std::istream &calibration, const std::string &name) noexcept
+        : m_matrix{}
+        , m_table{}
+        , m_hasMatrix(false)
+        , m_hasTable(false)
+        , m_valid(false) {
+        m_valid = load(calibration, name);
+    }
+
+    /**
+     * @return true if the calibration was loaded.
+     */
+    bool valid() const noexcept {
+        return m_valid;
+    }
+
+    /**
+     * This method converts the I420 frame described by layoutI420 into the
+     * corrected ARGB frame described by layoutARGB.
+     */
+    void convertI420ToARGB(const uint8_t *i420, const I420Layout &layoutI420, uint8_t *argb, const ARGBLayout &layoutARGB) const noexcept {
+        const int WIDTH{static_cast<int>(layoutI420.width)};
+        const int STRIDE{static_cast<int>(layoutARGB.stride)};
+        // Bands start at even rows so that they start at a chroma row.
+        for (uint32_t y{0}; y < layoutI420.height; y += BAND_HEIGHT) {
+            const int ROWS{static_cast<int>(std::min(uint32_t{BAND_HEIGHT}, layoutI420.height - y))};
+            uint8_t *band{argb + static_cast<std::size_t>(y) * layoutARGB.stride};
+            libyuv::I420ToARGB(i420 + layoutI420.offsetY + static_cast<std::size_t>(y) * layoutI420.strideY, static_cast<int>(layoutI420.strideY),
+                               i420 + layoutI420.offsetU + static_cast<std::size_t>(y / 2) * layoutI420.strideU, static_cast<int>(layoutI420.strideU),
+                               i420 + layoutI420.offsetV + static_cast<std::size_t>(y / 2) * layoutI420.strideV, static_cast<int>(layoutI420.strideV),
+                               band, STRIDE, WIDTH, ROWS);
+            if (m_hasMatrix) {
+                libyuv::ARGBColorMatrix(band, STRIDE, band, STRIDE, m_matrix, WIDTH, ROWS);
+            }
+            if (m_hasTable) {
+                libyuv::ARGBColorTable(band, STRIDE, m_table, 0, 0, WIDTH, ROWS);
+            }
+        }
+    }
+
+    /**
+     * @return CCM as libyuv's 4x4 matrix in B, G, R, A order.
+     */
+    const int8_t *matrix() const noexcept {
+        return m_matrix;
+    }
+
+    /**
+     * @return LUTs as libyuv's table of 256 B, G, R, A entries.
+     */
+    const uint8_t *table() const noexcept {
+        return m_table;
+    }
+
+   private:
+    bool load(std::istream &calibration, const std::string &name) noexcept {
+        float ccm[3][3]{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+        uint32_t lut[3][256];
+        for (uint32_t i{0}; i < 256; i++) {
+            lut[0][i] = lut[1][i] = lut[2][i] = i;
+        }
+        uint32_t ccmRows{0};
+        uint32_t lutEntries{0};
+        bool hasGamma{false};
+
+        std::string line;
+        uint32_t lineNumber{0};
+        while (std::getline(calibration, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream sstr(line);
+            std::string key;
+            if (!(sstr >> key)) {
+                continue;
+            }
+            bool isValid{false};
+            if ( ("ccm" == key) && (ccmRows < 3) ) {
+                isValid = static_cast<bool>(sstr >> ccm[ccmRows][0] >> ccm[ccmRows][1] >> ccm[ccmRows][2]);
+                ccmRows++;
+            }
+            else if ( ("gamma" == key) && !hasGamma && (0 == lutEntries) ) {
+                float gamma{0.0f};
+                isValid = static_cast<bool>(sstr >> gamma) && (gamma > 0.0f);
+                for (uint32_t i{0}; isValid && (i < 256); i++) {
+                    lut[0][i] = lut[1][i] = lut[2][i] = static_cast<uint32_t>(std::lround(255.0 * std::pow(i / 255.0, 1.0 / gamma)));
+                }
+                hasGamma = true;
+            }
+            else if ( ("lut" == key) && !hasGamma && (lutEntries < 256) ) {
+                isValid = static_cast<bool>(sstr >> lut[0][lutEntries] >> lut[1][lutEntries] >> lut[2][lutEntries]) &&
+                          (lut[0][lutEntries] < 256) && (lut[1][lutEntries] < 256) && (lut[2][lutEntries] < 256);
+                lutEntries++;
+            }
+            if (!isValid) {
+                std::cerr << "[opendlv-device-camera-opencv]: Invalid or unexpected entry in line " << lineNumber << " of colour correction '" << name << "'." << std::endl;
+                return false;
+            }
+        }
+        if ( ((0 != ccmRows) && (3 != ccmRows)) || ((0 != lutEntries) && (256 != lutEntries)) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: Colour correction '" << name << "' needs 3 ccm lines and 0 or 256 lut lines; found " << ccmRows << " and " << lutEntries << "." << std::endl;
+            return false;
+        }
+
+        // libyuv's ARGB is B, G, R, A in memory: row i of its matrix produces channel i from (B, G, R, A).
+        constexpr uint32_t CHANNEL[3]{2, 1, 0}; // Channel of R, G, and B in memory.
+        m_matrix[15] = 64;
+        bool isClamped{false};
+        for (uint32_t row{0}; row < 3; row++) {
+            for (uint32_t column{0}; column < 3; column++) {
+                const long FIXED{std::lround(ccm[row][column] * 64.0f)};
+                isClamped |= (FIXED < -128) || (FIXED > 127);
+                m_matrix[CHANNEL[row] * 4 + CHANNEL[column]] = static_cast<int8_t>(std::max(-128L, std::min(127L, FIXED)));
+                m_hasMatrix |= (FIXED != ((row == column) ? 64 : 0));
+            }
+        }
+        if (isClamped) {
+            std::cerr << "[opendlv-device-camera-opencv]: Colour correction '" << name << "' has coefficients outside of -2 to 1.984, which were clamped." << std::endl;
+        }
+        for (uint32_t i{0}; i < 256; i++) {
+            for (uint32_t channel{0}; channel < 3; channel++) {
+                m_table[i * 4 + CHANNEL[channel]] = static_cast<uint8_t>(lut[channel][i]);
+                m_hasTable |= (lut[channel][i] != i);
+            }
+            m_table[i * 4 + 3] = static_cast<uint8_t>(i);
+        }
+        return true;
+    }
+
+   private:
+    int8_t m_matrix[16];
+    uint8_t m_table[256 * 4];
+    bool m_hasMatrix;
+    bool m_hasTable;
+    bool m_valid;
+};
+
+#endif
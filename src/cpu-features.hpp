@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+#include <cstdlib>
+#include <string>
+
+// The binary is built for the baseline of its architecture (SSE2 on x86-64,
+// NEON on aarch64) so that one image runs on all of our machines. Kernels of
+// this microservice that profit from wider vectors are additionally compiled
+// for AVX2 and AVX-512 via target attributes and selected once at runtime from
+// the features reported by the CPU (and enabled by the OS). libyuv dispatches
+// its own row functions at runtime in the same way.
+//
+// Setting the environment variable OPENDLV_CPU_FEATURES to baseline, avx2, or
+// avx512 limits the selection, e.g., to compare variants on the same machine.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define HAVE_X86_DISPATCH
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+    #define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
+/**
+ * Instruction set extensions usable by the kernels of this microservice.
+ */
+struct CpuFeatures {
+    bool avx2{false};
+    bool avx512{false};
+};
+
+/**
+ * @return Instruction set extensions of this CPU, detected once.
+ */
+inline const CpuFeatures &cpuFeatures() noexcept {
+    static const CpuFeatures FEATURES{[]() {
+        CpuFeatures features;
+#ifdef HAVE_X86_DISPATCH
+        __builtin_cpu_init();
+        features.avx2 = (0 != __builtin_cpu_supports("avx2"));
+        features.avx512 = features.avx2 && (0 != __builtin_cpu_supports("avx512f")) && (0 != __builtin_cpu_supports("avx512bw"));
+#endif
+        const char *LIMIT{std::getenv("OPENDLV_CPU_FEATURES")};
+        if (nullptr != LIMIT) {
+            const std::string limit{LIMIT};
+            features.avx512 = features.avx512 && ("avx512" == limit);
+            features.avx2 = features.avx2 && (("avx2" == limit) || ("avx512" == limit));
+        }
+        return features;
+    }()};
+    return FEATURES;
+}
+
+/**
+ * @return Name of the baseline instruction set this binary was built for.
+ */
+inline const char *baselineInstructionSet() noexcept {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+#endif
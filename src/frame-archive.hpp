@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_ARCHIVE_HPP
+#define FRAME_ARCHIVE_HPP
+
+#include "frame-layout.hpp"
+#include "frame-metadata.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// A frame archive is one preallocated file that is memory-mapped as a whole:
+//
+// [FrameArchiveHeader][FrameArchiveIndexEntry * capacity][frame slots * capacity]
+//
+// Each frame slot is laid out like the I420 shared memory area: the I420 frame
+// as described by the header's layout followed by FrameMetadata at the end of
+// the slot. The index holds one entry per recorded frame similar to cluon's
+// IndexEntry so that a player can seek by time stamp without touching the
+// frames. Header, index, and slots start at page boundaries.
+
+/**
+ * Header at the beginning of a frame archive.
+ */
+struct FrameArchiveHeader {
+    static constexpr uint32_t MAGIC{0x4156444f}; // "ODVA" as little endian.
+    static constexpr uint32_t VERSION{1};
+    static constexpr uint32_t SIZE{4096};
+
+    uint32_t magic{MAGIC};
+    uint32_t version{VERSION};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t strideY{0};
+    uint32_t strideU{0};
+    uint32_t strideV{0};
+    uint32_t offsetY{0};
+    uint32_t offsetU{0};
+    uint32_t offsetV{0};
+    uint32_t frameSize{0};       // Bytes of the I420 frame in a slot.
+    uint32_t slotSize{0};        // Bytes of a slot including FrameMetadata.
+    uint64_t capacity{0};        // Number of slots.
+    uint64_t numberOfFrames{0};  // Number of recorded frames; updated after each frame.
+    uint64_t indexOffset{0};
+    uint64_t dataOffset{0};
+
+    uint8_t reserved[SIZE - 80]{};
+};
+static_assert(sizeof(FrameArchiveHeader) == FrameArchiveHeader::SIZE, "FrameArchiveHeader must not change its size.");
+
+/**
+ * Index entry per recorded frame.
+ */
+struct FrameArchiveIndexEntry {
+    int64_t sampleTimeStamp{0}; // Microseconds since epoch.
+    uint64_t sequenceNumber{0};
+    uint64_t filePosition{0};   // Begin of the frame's slot.
+};
+
+/**
+ * @return layout of the I420 frames in the given archive header.
+ */
+inline I420Layout i420Layout(const FrameArchiveHeader &header) noexcept {
+    I420Layout layout;
+    layout.width = header.width;
+    layout.height = header.height;
+    layout.strideY = header.strideY;
+    layout.strideU = header.strideU;
+    layout.strideV = header.strideV;
+    layout.offsetY = header.offsetY;
+    layout.offsetU = header.offsetU;
+    layout.offsetV = header.offsetV;
+    layout.size = header.frameSize;
+    return layout;
+}
+
+/**
+ * FrameArchive maps a frame archive file into memory, either to record into a
+ * new archive or to read an existing one.
+ */
+class FrameArchive {
+   private:
+    FrameArchive(const FrameArchive &) = delete;
+    FrameArchive(FrameArchive &&)      = delete;
+    FrameArchive &operator=(const FrameArchive &) = delete;
+    FrameArchive &operator=(FrameArchive &&) = delete;
+
+   public:
+    /**
+     * Constructor creating a new archive of the given size for I420 frames
+     * of the given layout; an existing file is overwritten.
+     */
+    FrameArchive(const std::string &filename, const I420Layout &layout, uint64_t size) noexcept
+        : m_filename(filename)
+        , m_fd(-1)
+        , m_data(nullptr)
+        , m_size(0)
+        , m_isWritable(true)
+        , m_header(nullptr)
+        , m_index(nullptr) {
+        const uint64_t PAGE_SIZE_BYTES{static_cast<uint64_t>(::sysconf(_SC_PAGESIZE))};
+        auto alignToPage = [PAGE_SIZE_BYTES](uint64_t v) { return ((v + PAGE_SIZE_BYTES - 1) / PAGE_SIZE_BYTES) * PAGE_SIZE_BYTES; };
+
+        FrameArchiveHeader header;
+        header.width = layout.width;
+        header.height = layout.height;
+        header.strideY = layout.strideY;
+        header.strideU = layout.strideU;
+        header.strideV = layout.strideV;
+        header.offsetY = layout.offsetY;
+        header.offsetU = layout.offsetU;
+        header.offsetV = layout.offsetV;
+        header.frameSize = layout.size;
+        header.slotSize = static_cast<uint32_t>(alignToPage(sizeWithFrameMetadata(layout.size)));
+        header.indexOffset = alignToPage(sizeof(FrameArchiveHeader));
+        const uint64_t AVAILABLE{(size > header.indexOffset) ? size - header.indexOffset : 0};
+        header.capacity = AVAILABLE / (header.slotSize + sizeof(FrameArchiveIndexEntry));
+        header.dataOffset = alignToPage(header.indexOffset + header.capacity * sizeof(FrameArchiveIndexEntry));
+        while ( (0 < header.capacity) && (header.dataOffset + header.capacity * header.slotSize > size) ) {
+            header.capacity--;
+            header.dataOffset = alignToPage(header.indexOffset + header.capacity * sizeof(FrameArchiveIndexEntry));
+        }
+        if (0 == header.capacity) {
+            std::cerr << "[opendlv-device-camera-opencv]: Archive size " << size << " is too small for a single frame." << std::endl;
+            return;
+        }
+
+        m_fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (-1 == m_fd) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to create '" << filename << "': " << ::strerror(errno) << std::endl;
+            return;
+        }
+        // Reserve the blocks up front so that recording never runs out of disk space midway;
+        // file systems without support for it get a sparse file instead.
+        m_size = header.dataOffset + header.capacity * header.slotSize;
+        const int RESULT{::posix_fallocate(m_fd, 0, static_cast<off_t>(m_size))};
+        if ( (0 != RESULT) && (0 != ::ftruncate(m_fd, static_cast<off_t>(m_size))) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to preallocate " << m_size << " bytes for '" << filename << "': " << ::strerror(RESULT) << std::endl;
+            close();
+            return;
+        }
+        if (map(PROT_READ | PROT_WRITE)) {
+            std::memcpy(m_data, &header, sizeof(FrameArchiveHeader));
+            m_header = reinterpret_cast<FrameArchiveHeader*>(m_data);
+            m_index = reinterpret_cast<FrameArchiveIndexEntry*>(m_data + header.indexOffset);
+        }
+    }
+
+    /**
+     * Constructor mapping an existing archive for reading.
+     */
+    explicit FrameArchive(const std::string &filename) noexcept
+        : m_filename(filename)
+        , m_fd(-1)
+        , m_data(nullptr)
+        , m_size(0)
+        , m_isWritable(false)
+        , m_header(nullptr)
+        , m_index(nullptr) {
+        m_fd = ::open(filename.c_str(), O_RDONLY);
+        struct stat fileStatus;
+        if ( (-1 == m_fd) || (0 != ::fstat(m_fd, &fileStatus)) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to open '" << filename << "': " << ::strerror(errno) << std::endl;
+            close();
+            return;
+        }
+        m_size = static_cast<uint64_t>(fileStatus.st_size);
+        if (m_size < sizeof(FrameArchiveHeader)) {
+            std::cerr << "[opendlv-device-camera-opencv]: '" << filename << "' is not a frame archive." << std::endl;
+            close();
+            return;
+        }
+        if (map(PROT_READ)) {
+            const FrameArchiveHeader *header{reinterpret_cast<const FrameArchiveHeader*>(m_data)};
+            if ( (FrameArchiveHeader::MAGIC != header->magic) || (FrameArchiveHeader::VERSION != header->version) ) {
+                std::cerr << "[opendlv-device-camera-opencv]: '" << filename << "' is not a frame archive of version " << FrameArchiveHeader::VERSION << "." << std::endl;
+                close();
+                return;
+            }
+            if (!isConsistent(*header)) {
+                std::cerr << "[opendlv-device-camera-opencv]: '" << filename << "' has an inconsistent header." << std::endl;
+                close();
+                return;
+            }
+            if ( (header->dataOffset > m_size) || (header->numberOfFrames > (m_size - header->dataOffset) / header->slotSize) ) {
+                std::cerr << "[opendlv-device-camera-opencv]: '" << filename << "' is truncated." << std::endl;
+                close();
+                return;
+            }
+            // Frames are mostly read in order; let the kernel read ahead.
+            ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+            m_header = reinterpret_cast<FrameArchiveHeader*>(m_data);
+            m_index = reinterpret_cast<FrameArchiveIndexEntry*>(m_data + header->indexOffset);
+        }
+    }
+
+    ~FrameArchive() noexcept {
+        // Cut off the slots that were not used.
+        const uint64_t USED{(valid() && m_isWritable) ? m_header->dataOffset + m_header->numberOfFrames * m_header->slotSize : 0};
+        close();
+        if (0 < USED) {
+            if (0 != ::truncate(m_filename.c_str(), static_cast<off_t>(USED))) {
+                std::cerr << "[opendlv-device-camera-opencv]: Failed to truncate '" << m_filename << "': " << ::strerror(errno) << std::endl;
+            }
+        }
+    }
+
+    bool valid() const noexcept {
+        return (nullptr != m_header);
+    }
+
+    FrameArchiveHeader &header() noexcept {
+        return *m_header;
+    }
+
+    const FrameArchiveHeader &header() const noexcept {
+        return *m_header;
+    }
+
+    FrameArchiveIndexEntry &indexEntry(uint64_t i) noexcept {
+        return m_index[i];
+    }
+
+    const FrameArchiveIndexEntry &indexEntry(uint64_t i) const noexcept {
+        return m_index[i];
+    }
+
+    char *slot(uint64_t i) noexcept {
+        return m_data + m_header->dataOffset + i * m_header->slotSize;
+    }
+
+    const char *slot(uint64_t i) const noexcept {
+        return m_data + m_header->dataOffset + i * m_header->slotSize;
+    }
+
+    /**
+     * @return Position of the first recorded frame with a sample time stamp
+     *         not before the given one, or numberOfFrames if there is none.
+     */
+    uint64_t find(int64_t sampleTimeStamp) const noexcept {
+        const FrameArchiveIndexEntry *begin{m_index};
+        const FrameArchiveIndexEntry *end{m_index + m_header->numberOfFrames};
+        const FrameArchiveIndexEntry *entry{std::lower_bound(begin, end, sampleTimeStamp, [](const FrameArchiveIndexEntry &e, int64_t ts) { return e.sampleTimeStamp < ts; })};
+        return static_cast<uint64_t>(entry - begin);
+    }
+
+    /**
+     * This method asks the kernel to read the given slot ahead of its use.
+     */
+    void prefetch(uint64_t i) const noexcept {
+        if (i < m_header->numberOfFrames) {
+            ::madvise(const_cast<char*>(slot(i)), m_header->slotSize, MADV_WILLNEED);
+        }
+    }
+
+    /**
+     * This method starts writing the given slot back to disk without waiting for it.
+     */
+    void writeBack(uint64_t i) noexcept {
+#if defined(__linux__)
+        ::sync_file_range(m_fd, static_cast<off_t>(m_header->dataOffset + i * m_header->slotSize), m_header->slotSize, SYNC_FILE_RANGE_WRITE);
+#else
+        ::msync(slot(i), m_header->slotSize, MS_ASYNC);
+#endif
+    }
+
+   private:
+    // The index must fit into the file before the slots, and the planes and the
+    // FrameMetadata must fit into a slot; the slots themselves are checked against
+    // the file's size for the recorded frames only as unused slots are cut off.
+    bool isConsistent(const FrameArchiveHeader &header) const noexcept {
+        auto fits = [&header](uint64_t offset, uint64_t stride, uint64_t columns, uint64_t rows) {
+            return (stride >= columns) && (offset + stride * rows <= header.frameSize);
+        };
+        return (header.indexOffset >= sizeof(FrameArchiveHeader))
+            && (header.capacity <= m_size / sizeof(FrameArchiveIndexEntry))
+            && (header.indexOffset + header.capacity * sizeof(FrameArchiveIndexEntry) <= std::min(header.dataOffset, m_size))
+            && (header.numberOfFrames <= header.capacity)
+            && ((static_cast<uint64_t>(header.frameSize) + 7) / 8 * 8 + sizeof(FrameMetadata) <= header.slotSize)
+            && fits(header.offsetY, header.strideY, header.width, header.height)
+            && fits(header.offsetU, header.strideU, chromaWidth(header.width), chromaHeight(header.height))
+            && fits(header.offsetV, header.strideV, chromaWidth(header.width), chromaHeight(header.height));
+    }
+
+    // Archives are far larger than the RAM that should be locked. After
+    // mlockall(MCL_FUTURE) (see lockMemory), mmap() locks and reads in the whole
+    // mapping at once unless it is inaccessible; hence, the file is mapped
+    // without access first, unlocked, and made accessible afterwards.
+    bool map(int protection) noexcept {
+        void *ptr{::mmap(nullptr, m_size, PROT_NONE, MAP_SHARED | MAP_NORESERVE, m_fd, 0)};
+        if (MAP_FAILED == ptr) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to map '" << m_filename << "': " << ::strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+        m_data = static_cast<char*>(ptr);
+        ::munlock(m_data, m_size);
+        if (0 != ::mprotect(m_data, m_size, protection)) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to map '" << m_filename << "': " << ::strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() noexcept {
+        if (nullptr != m_data) {
+            ::munmap(m_data, m_size);
+        }
+        if (-1 != m_fd) {
+            ::close(m_fd);
+        }
+        m_fd = -1;
+        m_data = nullptr;
+        m_header = nullptr;
+        m_index = nullptr;
+    }
+
+   private:
+    const std::string m_filename;
+    int m_fd;
+    char *m_data;
+    uint64_t m_size;
+    const bool m_isWritable;
+    FrameArchiveHeader *m_header;
+    FrameArchiveIndexEntry *m_index;
+};
+
+#endif
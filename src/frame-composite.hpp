@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_COMPOSITE_HPP
+#define FRAME_COMPOSITE_HPP
+
+#include "frame-layout.hpp"
+
+#include <libyuv.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * FrameComposite describes one I420 frame that holds the frames of several
+ * cameras as tiles: tile i is at column i % columns() and row i / columns(),
+ * and each tile is a camera's frame downscaled by an integer factor. Tiles
+ * have even sizes so that their chroma samples are not shared with their
+ * neighbours; each tile can therefore be described as I420 layout with the
+ * strides of the composite and offsets into it.
+ */
+class FrameComposite {
+   private:
+    FrameComposite(const FrameComposite &) = delete;
+    FrameComposite(FrameComposite &&)      = delete;
+    FrameComposite &operator=(const FrameComposite &) = delete;
+    FrameComposite &operator=(FrameComposite &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param width Width of the cameras' frames.
+     * @param height Height of the cameras' frames.
+     * @param numberOfTiles Number of cameras.
+     * @param columns Number of tiles per row.
+     * @param scale Factor by which the frames are downscaled.
+     * @param strideAlignment Alignment of the rows of the composite in bytes.
+     * @param planeAlignment Alignment of the planes of the composite in bytes.
+     */
+    FrameComposite(uint32_t width, uint32_t height, uint32_t numberOfTiles, uint32_t columns, uint32_t scale, uint32_t strideAlignment, uint32_t planeAlignment) noexcept
+        : m_columns(std::max(1u, std::min(columns, numberOfTiles)))
+        , m_rows((numberOfTiles + m_columns - 1) / m_columns)
+        , m_tileWidth(std::max(2u, (width / scale) & ~1u))
+        , m_tileHeight(std::max(2u, (height / scale) & ~1u))
+        , m_layout(i420Layout(m_columns * m_tileWidth, m_rows * m_tileHeight, strideAlignment, planeAlignment)) {}
+
+    /**
+     * @return Layout of the composite.
+     */
+    const I420Layout &layout() const noexcept {
+        return m_layout;
+    }
+
+    /**
+     * @return Number of tiles per row.
+     */
+    uint32_t columns() const noexcept {
+        return m_columns;
+    }
+
+    /**
+     * @return Number of rows of tiles.
+     */
+    uint32_t rows() const noexcept {
+        return m_rows;
+    }
+
+    /**
+     * @return Layout of tile i within the composite.
+     */
+    I420Layout tile(uint32_t i) const noexcept {
+        const uint32_t X{(i % m_columns) * m_tileWidth};
+        const uint32_t Y{(i / m_columns) * m_tileHeight};
+        I420Layout layout{m_layout};
+        layout.width = m_tileWidth;
+        layout.height = m_tileHeight;
+        layout.offsetY = m_layout.offsetY + Y * m_layout.strideY + X;
+        layout.offsetU = m_layout.offsetU + Y / 2 * m_layout.strideU + X / 2;
+        layout.offsetV = m_layout.offsetV + Y / 2 * m_layout.strideV + X / 2;
+        return layout;
+    }
+
+    /**
+     * This method fills the composite with black, e.g., for tiles without camera.
+     */
+    void clear(uint8_t *composite) const noexcept {
+        std::memset(composite + m_layout.offsetY, 16, m_layout.offsetU - m_layout.offsetY);
+        std::memset(composite + m_layout.offsetU, 128, m_layout.size - m_layout.offsetU);
+    }
+
+    /**
+     * This method writes the I420 frame described by layoutI420 into tile i of
+     * the composite; libyuv copies the planes if no scaling is needed and
+     * averages boxes of pixels otherwise.
+     */
+    void add(uint32_t i, const uint8_t *i420, const I420Layout &layoutI420, uint8_t *composite) const noexcept {
+        const I420Layout TILE{tile(i)};
+        libyuv::I420Scale(i420 + layoutI420.offsetY, static_cast<int>(layoutI420.strideY),
+                          i420 + layoutI420.offsetU, static_cast<int>(layoutI420.strideU),
+                          i420 + layoutI420.offsetV, static_cast<int>(layoutI420.strideV),
+                          static_cast<int>(layoutI420.width), static_cast<int>(layoutI420.height),
+                          composite + TILE.offsetY, static_cast<int>(TILE.strideY),
+                          composite + TILE.offsetU, static_cast<int>(TILE.strideU),
+                          composite + TILE.offsetV, static_cast<int>(TILE.strideV),
+                          static_cast<int>(TILE.width), static_cast<int>(TILE.height), libyuv::kFilterBox);
+    }
+
+   private:
+    const uint32_t m_columns;
+    const uint32_t m_rows;
+    const uint32_t m_tileWidth;
+    const uint32_t m_tileHeight;
+    const I420Layout m_layout;
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CONVERSION_HPP
+#define FRAME_CONVERSION_HPP
+
+#include "frame-layout.hpp"
+
+#include <libyuv.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * This function converts an RGB24 frame into I420 planes like
+ * libyuv::RGB24ToI420 does, which allocates a row buffer on the heap in every
+ * call on platforms without RGB24 row functions (e.g., x86). Instead, bands of
+ * 2 rows and at most 1024 columns go through ARGB on the stack. Without u and
+ * v, only the luma is converted.
+ */
+inline void convertRGB24(const uint8_t *frame, uint32_t width, uint32_t height,
+                         uint8_t *y, uint32_t strideY, uint8_t *u, uint32_t strideU, uint8_t *v, uint32_t strideV,
+                         bool flipVertically) noexcept {
+    constexpr uint32_t BAND_WIDTH{1024};
+    alignas(64) uint8_t argb[2 * BAND_WIDTH * 4];
+    const uint32_t STRIDE{rgb24Stride(width)};
+    for (uint32_t row{0}; row < height; row += 2) {
+        const uint32_t ROWS{std::min(2u, height - row)};
+        // A flipped band starts at the mirrored rows and is flipped by a negative height.
+        const uint8_t *band{frame + static_cast<std::size_t>(flipVertically ? height - row - ROWS : row) * STRIDE};
+        for (uint32_t x{0}; x < width; x += BAND_WIDTH) {
+            const uint32_t COLUMNS{std::min(BAND_WIDTH, width - x)};
+            libyuv::RGB24ToARGB(band + rgb24Stride(x), static_cast<int>(STRIDE),
+                                argb, static_cast<int>(BAND_WIDTH * 4),
+                                static_cast<int>(COLUMNS), flipVertically ? -static_cast<int>(ROWS) : static_cast<int>(ROWS));
+            uint8_t *bandY{y + static_cast<std::size_t>(row) * strideY + x};
+            if (nullptr == u) {
+                libyuv::ARGBToI400(argb, static_cast<int>(BAND_WIDTH * 4),
+                                   bandY, static_cast<int>(strideY),
+                                   static_cast<int>(COLUMNS), static_cast<int>(ROWS));
+            }
+            else {
+                libyuv::ARGBToI420(argb, static_cast<int>(BAND_WIDTH * 4),
+                                   bandY, static_cast<int>(strideY),
+                                   u + static_cast<std::size_t>(row / 2) * strideU + x / 2, static_cast<int>(strideU),
+                                   v + static_cast<std::size_t>(row / 2) * strideV + x / 2, static_cast<int>(strideV),
+                                   static_cast<int>(COLUMNS), static_cast<int>(ROWS));
+            }
+        }
+    }
+}
+
+/**
+ * This function converts a captured YUYV422 or RGB24 frame (i.e., OpenCV's BGR)
+ * into the I420 frame described by layout. Odd widths and heights are supported
+ * as libyuv subsamples the trailing column and row on its own. With
+ * flipVertically, the frame is read bottom-up at no extra cost.
+ */
+inline void convertToI420(const uint8_t *frame, bool isYUYV422, uint8_t *i420, const I420Layout &layout, bool flipVertically = false) noexcept {
+    if (isYUYV422) {
+        // libyuv reads the source from its last row upwards for negative heights.
+        const int HEIGHT{flipVertically ? -static_cast<int>(layout.height) : static_cast<int>(layout.height)};
+        libyuv::YUY2ToI420(frame, static_cast<int>(yuyv422Stride(layout.width)),
+                           i420 + layout.offsetY, static_cast<int>(layout.strideY),
+                           i420 + layout.offsetU, static_cast<int>(layout.strideU),
+                           i420 + layout.offsetV, static_cast<int>(layout.strideV),
+                           static_cast<int>(layout.width), HEIGHT);
+    }
+    else {
+        convertRGB24(frame, layout.width, layout.height,
+                     i420 + layout.offsetY, layout.strideY,
+                     i420 + layout.offsetU, layout.strideU,
+                     i420 + layout.offsetV, layout.strideV,
+                     flipVertically);
+    }
+}
+
+/**
+ * This function extracts the luma of a captured YUYV422 or RGB24 frame into
+ * the grayscale frame described by layout. The Y samples of YUYV422 frames are
+ * copied as they are; RGB24 frames are converted to the same limited-range
+ * (BT.601) luma as the Y plane of the I420 frames.
+ */
+inline void convertToGray(const uint8_t *frame, bool isYUYV422, uint8_t *gray, const GrayLayout &layout, bool flipVertically = false) noexcept {
+    if (isYUYV422) {
+        const int HEIGHT{flipVertically ? -static_cast<int>(layout.height) : static_cast<int>(layout.height)};
+        libyuv::YUY2ToY(frame, static_cast<int>(yuyv422Stride(layout.width)),
+                        gray, static_cast<int>(layout.stride),
+                        static_cast<int>(layout.width), HEIGHT);
+    }
+    else {
+        convertRGB24(frame, layout.width, layout.height, gray, layout.stride, nullptr, 0, nullptr, 0, flipVertically);
+    }
+}
+
+/**
+ * This function converts the I420 frame described by layoutI420 into the ARGB
+ * frame described by layoutARGB.
+ */
+inline void convertI420ToARGB(const uint8_t *i420, const I420Layout &layoutI420, uint8_t *argb, const ARGBLayout &layoutARGB) noexcept {
+    libyuv::I420ToARGB(i420 + layoutI420.offsetY, static_cast<int>(layoutI420.strideY),
+                       i420 + layoutI420.offsetU, static_cast<int>(layoutI420.strideU),
+                       i420 + layoutI420.offsetV, static_cast<int>(layoutI420.strideV),
+                       argb, static_cast<int>(layoutARGB.stride),
+                       static_cast<int>(layoutI420.width), static_cast<int>(layoutI420.height));
+}
+
+#endif
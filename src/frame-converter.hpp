@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CONVERTER_HPP
+#define FRAME_CONVERTER_HPP
+
+#include "cluon-complete.hpp"
+#include "colour-correction.hpp"
+#include "frame-conversion.hpp"
+#include "frame-layout.hpp"
+#include "frame-metadata.hpp"
+#include "frame-pipeline.hpp"
+#include "frame-pool.hpp"
+#include "luma-histogram.hpp"
+#include "luma-sharpness.hpp"
+#include "temporal-denoiser.hpp"
+
+#include <cstdint>
+
+/**
+ * This function stores the time stamps of the given frame and its position
+ * in the published sequence in metadata.
+ */
+inline void setFrameMetadata(FrameMetadata &metadata, const Frame &frame, uint64_t sequenceNumber, uint32_t flags, uint32_t discontinuities) noexcept {
+    metadata.sequenceNumber = sequenceNumber;
+    metadata.flags = flags;
+    metadata.discontinuities = discontinuities;
+    metadata.sampleTimeStamp = cluon::time::toMicroseconds(frame.sampleTimeStamp);
+    metadata.captureTimeStamp = frame.captureTime;
+}
+
+/**
+ * FrameConverter does the per-frame work of the conversion thread for one
+ * camera: it converts a captured frame into the I420 area, denoises it,
+ * computes its luma statistics and sharpness, converts the I420 frame into
+ * the ARGB area, and keeps the metadata of both areas. Locking, publishing,
+ * and notifying the areas is left to the caller.
+ */
+class FrameConverter {
+   private:
+    FrameConverter(const FrameConverter &) = delete;
+    FrameConverter(FrameConverter &&)      = delete;
+    FrameConverter &operator=(const FrameConverter &) = delete;
+    FrameConverter &operator=(FrameConverter &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param pipeline Pipeline converting frames of layoutI420 and layoutARGB; it must outlive this object.
+     * @param isYUYV422 true if the captured frames are YUYV422, false for RGB24.
+     * @param layoutI420 Layout of the I420 area.
+     * @param layoutARGB Layout of the ARGB area.
+     * @param hasLumaStatistics Compute the luma statistics of each frame.
+     * @param hasSharpness Compute the sharpness of each frame.
+     * @param colourCorrection Optional colour correction of the ARGB frames; it must outlive this object.
+     * @param denoiser Optional denoiser for frames of layoutI420; it must outlive this object.
+     */
+    FrameConverter(FramePipeline &pipeline, bool isYUYV422, const I420Layout &layoutI420, const ARGBLayout &layoutARGB,
+                   bool hasLumaStatistics, bool hasSharpness, const ColourCorrection *colourCorrection, TemporalDenoiser *denoiser) noexcept
+        : m_pipeline(pipeline)
+        , m_isYUYV422(isYUYV422)
+        , m_layoutI420(layoutI420)
+        , m_layoutARGB(layoutARGB)
+        , m_hasLumaStatistics(hasLumaStatistics)
+        , m_hasSharpness(hasSharpness)
+        , m_colourCorrection(colourCorrection)
+        , m_denoiser(denoiser)
+        , m_lumaStatistics()
+        , m_metadataI420()
+        , m_metadataARGB() {
+        setLayout(m_metadataI420, m_layoutI420);
+        setLayout(m_metadataARGB, m_layoutARGB);
+    }
+
+    /**
+     * This method prepares the metadata of both areas for the given frame.
+     *
+     * @param syncSpread Spread of the set the frame belongs to in microseconds.
+     */
+    void setFrame(const Frame &frame, uint64_t sequenceNumber, uint32_t flags, uint32_t discontinuities, uint32_t syncSpread = 0) noexcept {
+        setFrameMetadata(m_metadataI420, frame, sequenceNumber, flags, discontinuities);
+        setFrameMetadata(m_metadataARGB, frame, sequenceNumber, flags, discontinuities);
+        m_metadataI420.syncSpread = m_metadataARGB.syncSpread = syncSpread;
+    }
+
+    /**
+     * This method converts the given frame into the I420 area and fills in the
+     * statistics of both areas' metadata; the I420 area must be locked.
+     */
+    void convertToI420(const Frame &frame, uint8_t *i420) noexcept {
+        m_pipeline.convertToI420(frame.image.data, m_isYUYV422, i420);
+        if (nullptr != m_denoiser) {
+            if (frame.discontinuity) {
+                m_denoiser->reset();
+            }
+            m_denoiser->apply(i420);
+        }
+        if (m_hasLumaStatistics) {
+            m_lumaStatistics = m_pipeline.lumaStatistics(i420);
+            setLumaStatistics(m_metadataI420, m_lumaStatistics);
+            setLumaStatistics(m_metadataARGB, m_lumaStatistics);
+        }
+        if (m_hasSharpness) {
+            const LaplacianSums SHARPNESS{laplacianSums(i420 + m_layoutI420.offsetY, m_layoutI420.strideY, m_layoutI420.width, m_layoutI420.height)};
+            setSharpness(m_metadataI420, SHARPNESS);
+            setSharpness(m_metadataARGB, SHARPNESS);
+        }
+    }
+
+    /**
+     * This method converts the I420 frame into the ARGB area, applying the
+     * colour correction if any; the ARGB area must be locked.
+     */
+    void convertToARGB(const uint8_t *i420, uint8_t *argb) const noexcept {
+        if (nullptr != m_colourCorrection) {
+            // The colour correction is applied in bands during the conversion to ARGB.
+            m_colourCorrection->convertI420ToARGB(i420, m_layoutI420, argb, m_layoutARGB);
+        }
+        else {
+            m_pipeline.convertToARGB(i420, argb);
+        }
+    }
+
+    /**
+     * @return Luma statistics of the last frame.
+     */
+    const LumaStatistics &lumaStatistics() const noexcept {
+        return m_lumaStatistics;
+    }
+
+    FrameMetadata &metadataI420() noexcept {
+        return m_metadataI420;
+    }
+
+    FrameMetadata &metadataARGB() noexcept {
+        return m_metadataARGB;
+    }
+
+   private:
+    FramePipeline &m_pipeline;
+    const bool m_isYUYV422;
+    const I420Layout m_layoutI420;
+    const ARGBLayout m_layoutARGB;
+    const bool m_hasLumaStatistics;
+    const bool m_hasSharpness;
+    const ColourCorrection *m_colourCorrection;
+    TemporalDenoiser *m_denoiser;
+    LumaStatistics m_lumaStatistics;
+    FrameMetadata m_metadataI420;
+    FrameMetadata m_metadataARGB;
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_LAYOUT_HPP
+#define FRAME_LAYOUT_HPP
+
+#include <cstdint>
+
+/**
+ * Layout of an I420 frame in memory: the Y plane is followed by the U and the
+ * V plane, each starting at its offset and each row starting at a multiple of
+ * the plane's stride.
+ */
+struct I420Layout {
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t strideY{0};
+    uint32_t strideU{0};
+    uint32_t strideV{0};
+    uint32_t offsetY{0};
+    uint32_t offsetU{0};
+    uint32_t offsetV{0};
+    uint32_t size{0};
+};
+
+/**
+ * Layout of an ARGB frame in memory.
+ */
+struct ARGBLayout {
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t stride{0};
+    uint32_t size{0};
+};
+
+/**
+ * Layout of a grayscale frame (i.e., only the luma plane) in memory.
+ */
+struct GrayLayout {
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t stride{0};
+    uint32_t size{0};
+};
+
+// Offsets and alignments are relative to the start of the shared memory area as
+// returned by cluon::SharedMemory::data(), which is page-aligned for SysV shared
+// memory but follows cluon's header for POSIX shared memory.
+
+// The helpers below are constexpr so that pipelines for fixed geometries
+// (cf. frame-pipeline.hpp) have their layouts computed at compile time.
+
+constexpr uint32_t alignUp(uint32_t value, uint32_t alignment) noexcept {
+    return (alignment > 1) ? ((value + alignment - 1) / alignment) * alignment : value;
+}
+
+/**
+ * @return Width of the chroma planes; odd widths round up so that the last column keeps its chroma.
+ */
+constexpr uint32_t chromaWidth(uint32_t width) noexcept {
+    return (width + 1) / 2;
+}
+
+/**
+ * @return Height of the chroma planes; odd heights round up so that the last row keeps its chroma.
+ */
+constexpr uint32_t chromaHeight(uint32_t height) noexcept {
+    return (height + 1) / 2;
+}
+
+/**
+ * @return Bytes per row of a YUYV422 frame; a trailing odd pixel occupies a full macropixel.
+ */
+constexpr uint32_t yuyv422Stride(uint32_t width) noexcept {
+    return chromaWidth(width) * 4;
+}
+
+/**
+ * @return Bytes per row of an RGB24 frame.
+ */
+constexpr uint32_t rgb24Stride(uint32_t width) noexcept {
+    return width * 3;
+}
+
+/**
+ * @return I420 layout with rows padded to strideAlignment bytes and planes starting at multiples of planeAlignment bytes.
+ */
+constexpr I420Layout i420Layout(uint32_t width, uint32_t height, uint32_t strideAlignment = 1, uint32_t planeAlignment = 1) noexcept {
+    I420Layout layout{};
+    layout.width = width;
+    layout.height = height;
+    layout.strideY = alignUp(width, strideAlignment);
+    layout.strideU = alignUp(chromaWidth(width), strideAlignment);
+    layout.strideV = layout.strideU;
+    layout.offsetY = 0;
+    layout.offsetU = alignUp(layout.offsetY + layout.strideY * height, planeAlignment);
+    layout.offsetV = alignUp(layout.offsetU + layout.strideU * chromaHeight(height), planeAlignment);
+    layout.size = layout.offsetV + layout.strideV * chromaHeight(height);
+    return layout;
+}
+
+/**
+ * @return ARGB layout with rows padded to strideAlignment bytes.
+ */
+constexpr ARGBLayout argbLayout(uint32_t width, uint32_t height, uint32_t strideAlignment = 1) noexcept {
+    ARGBLayout layout{};
+    layout.width = width;
+    layout.height = height;
+    layout.stride = alignUp(width * 4, strideAlignment);
+    layout.size = layout.stride * height;
+    return layout;
+}
+
+/**
+ * @return Grayscale layout with rows padded to strideAlignment bytes.
+ */
+constexpr GrayLayout grayLayout(uint32_t width, uint32_t height, uint32_t strideAlignment = 1) noexcept {
+    GrayLayout layout{};
+    layout.width = width;
+    layout.height = height;
+    layout.stride = alignUp(width, strideAlignment);
+    layout.size = layout.stride * height;
+    return layout;
+}
+
+#endif
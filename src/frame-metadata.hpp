@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_METADATA_HPP
+#define FRAME_METADATA_HPP
+
+#include "frame-layout.hpp"
+#include "luma-histogram.hpp"
+#include "luma-sharpness.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Metadata describing the frame that is currently residing in a shared memory
+ * area. It is stored in the last sizeof(FrameMetadata) bytes of each shared
+ * memory area and it is only valid while holding the shared memory's lock.
+ *
+ * Consumers that are not interested in the metadata can ignore these trailing
+ * bytes as the image data still starts at the beginning of the shared memory.
+ *
+ * The size of FrameMetadata is fixed; new fields are taken from the reserved
+ * bytes and announced by incrementing VERSION so that consumers built against
+ * an older version of this header keep working.
+ */
+struct FrameMetadata {
+    static constexpr uint32_t MAGIC{0x4d56444f}; // "ODVM" as little endian.
+    static constexpr uint32_t VERSION{7};
+    static constexpr uint32_t FOURCC_I420{0x30323449}; // "I420" as little endian.
+    static constexpr uint32_t FOURCC_ARGB{0x42475241}; // "ARGB" as little endian.
+    static constexpr uint32_t FOURCC_GREY{0x59455247}; // "GREY" as little endian.
+    static constexpr uint32_t SIZE{1024};
+    static constexpr uint32_t LUMA_HISTOGRAM_BINS{64};
+    static constexpr uint32_t FLAG_DISCONTINUITY{1}; // Frames were missed right before this frame.
+    static constexpr uint32_t FLAG_KEEP_ALIVE{2};    // Frame did not change since the previous one and is only published to show liveness.
+
+    uint32_t magic{MAGIC};
+    uint32_t version{VERSION};
+    uint64_t sequenceNumber{0};    // Consecutively increasing number of published frames.
+    int64_t sampleTimeStamp{0};    // Microseconds since epoch; same as the shared memory's time stamp.
+    int64_t publishTimeStamp{0};   // Microseconds since epoch; taken right before the consumers are notified.
+
+    // Since version 2: layout of the image in this shared memory area; plane i
+    // starts at data() + offset[i] and its rows are stride[i] bytes apart.
+    uint32_t fourcc{0};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t numberOfPlanes{0};
+    uint32_t stride[3]{};
+    uint32_t offset[3]{};
+
+    // Since version 3: statistics of the subsampled Y plane (cf. luma-histogram.hpp);
+    // lumaSamples is 0 if they were not computed for this frame. Bin i of
+    // lumaHistogram counts the samples with luma values 4*i to 4*i+3.
+    uint32_t lumaSamples{0};
+    uint32_t lumaMean{0};          // Mean luma times 256.
+    uint32_t lumaClippedDark{0};   // Samples at or below LUMA_CLIPPED_DARK.
+    uint32_t lumaClippedBright{0}; // Samples at or above LUMA_CLIPPED_BRIGHT.
+    uint32_t lumaHistogram[LUMA_HISTOGRAM_BINS]{};
+
+    // Since version 4: FLAG_* bits describing this frame.
+    uint32_t flags{0};
+    uint32_t discontinuities{0}; // Number of frames flagged with FLAG_DISCONTINUITY so far.
+
+    // Since version 5: sharpness of the Y plane as variance of its Laplacian
+    // (cf. luma-sharpness.hpp); sharpnessSamples is 0 if it was not computed
+    // for this frame. Together with the luma statistics of version 3, blurred,
+    // dark, or overexposed frames can be discarded without reading any pixel.
+    uint32_t sharpnessSamples{0};
+    uint32_t sharpness{0};         // Variance of the Laplacian, rounded.
+
+    // Since version 6: capture time from the camera driver and, with several
+    // synchronized cameras, the position of this frame in its set; all frames
+    // of a set carry the same sequenceNumber. numberOfCameras is 1 otherwise.
+    int64_t captureTimeStamp{0};   // Microseconds on the monotonic clock; the driver's time stamp where available.
+    uint32_t cameraIndex{0};
+    uint32_t numberOfCameras{1};
+    uint32_t syncSpread{0};        // Microseconds between the earliest and latest capture time of the set.
+
+    // Since version 7: for a composite of all cameras of a set, the frame of
+    // camera i is the tile at column i % tileColumns and row i / tileColumns;
+    // each tile is width / tileColumns by height / tileRows pixels. Both are 0
+    // for frames of a single camera.
+    uint32_t tileColumns{0};
+    uint32_t tileRows{0};
+
+    uint8_t reserved[SIZE - 388]{};
+};
+static_assert(sizeof(FrameMetadata) == FrameMetadata::SIZE, "FrameMetadata must not change its size.");
+
+/**
+ * This function describes the given I420 layout in metadata.
+ */
+inline void setLayout(FrameMetadata &metadata, const I420Layout &layout) noexcept {
+    metadata.fourcc = FrameMetadata::FOURCC_I420;
+    metadata.width = layout.width;
+    metadata.height = layout.height;
+    metadata.numberOfPlanes = 3;
+    metadata.stride[0] = layout.strideY;
+    metadata.stride[1] = layout.strideU;
+    metadata.stride[2] = layout.strideV;
+    metadata.offset[0] = layout.offsetY;
+    metadata.offset[1] = layout.offsetU;
+    metadata.offset[2] = layout.offsetV;
+}
+
+/**
+ * This function describes the given ARGB layout in metadata.
+ */
+inline void setLayout(FrameMetadata &metadata, const ARGBLayout &layout) noexcept {
+    metadata.fourcc = FrameMetadata::FOURCC_ARGB;
+    metadata.width = layout.width;
+    metadata.height = layout.height;
+    metadata.numberOfPlanes = 1;
+    metadata.stride[0] = layout.stride;
+    metadata.stride[1] = metadata.stride[2] = 0;
+    metadata.offset[0] = metadata.offset[1] = metadata.offset[2] = 0;
+}
+
+/**
+ * This function describes the given grayscale layout in metadata.
+ */
+inline void setLayout(FrameMetadata &metadata, const GrayLayout &layout) noexcept {
+    metadata.fourcc = FrameMetadata::FOURCC_GREY;
+    metadata.width = layout.width;
+    metadata.height = layout.height;
+    metadata.numberOfPlanes = 1;
+    metadata.stride[0] = layout.stride;
+    metadata.stride[1] = metadata.stride[2] = 0;
+    metadata.offset[0] = metadata.offset[1] = metadata.offset[2] = 0;
+}
+
+/**
+ * This function stores the given luma statistics in metadata.
+ */
+inline void setLumaStatistics(FrameMetadata &metadata, const LumaStatistics &statistics) noexcept {
+    metadata.lumaSamples = statistics.samples;
+    metadata.lumaMean = static_cast<uint32_t>(statistics.mean * 256.0f);
+    metadata.lumaClippedDark = metadata.lumaClippedBright = 0;
+    for (uint32_t i{0}; i < 256; i++) {
+        metadata.lumaClippedDark += (i <= LUMA_CLIPPED_DARK) ? statistics.histogram[i] : 0;
+        metadata.lumaClippedBright += (i >= LUMA_CLIPPED_BRIGHT) ? statistics.histogram[i] : 0;
+    }
+    constexpr uint32_t VALUES_PER_BIN{256 / FrameMetadata::LUMA_HISTOGRAM_BINS};
+    for (uint32_t bin{0}; bin < FrameMetadata::LUMA_HISTOGRAM_BINS; bin++) {
+        uint32_t count{0};
+        for (uint32_t i{0}; i < VALUES_PER_BIN; i++) {
+            count += statistics.histogram[bin * VALUES_PER_BIN + i];
+        }
+        metadata.lumaHistogram[bin] = count;
+    }
+}
+
+/**
+ * This function stores the sharpness described by the given Laplacian sums in metadata.
+ */
+inline void setSharpness(FrameMetadata &metadata, const LaplacianSums &sums) noexcept {
+    metadata.sharpnessSamples = static_cast<uint32_t>(sums.samples);
+    metadata.sharpness = static_cast<uint32_t>(laplacianVariance(sums) + 0.5f);
+}
+
+/**
+ * @return Size for a shared memory area holding imageSize bytes followed by FrameMetadata.
+ */
+inline uint32_t sizeWithFrameMetadata(uint32_t imageSize) noexcept {
+    constexpr uint32_t ALIGNMENT{8};
+    return ((imageSize + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT + static_cast<uint32_t>(sizeof(FrameMetadata));
+}
+
+/**
+ * This function stores the given metadata at the end of the given shared memory area.
+ */
+inline void writeFrameMetadata(char *data, uint32_t size, const FrameMetadata &metadata) noexcept {
+    if ( (nullptr != data) && (size >= sizeof(FrameMetadata)) ) {
+        std::memcpy(data + size - sizeof(FrameMetadata), &metadata, sizeof(FrameMetadata));
+    }
+}
+
+/**
+ * This function reads the metadata from the end of the given shared memory area.
+ *
+ * @return true if valid metadata was found.
+ */
+inline bool readFrameMetadata(const char *data, uint32_t size, FrameMetadata &metadata) noexcept {
+    bool retVal{false};
+    if ( (nullptr != data) && (size >= sizeof(FrameMetadata)) ) {
+        std::memcpy(&metadata, data + size - sizeof(FrameMetadata), sizeof(FrameMetadata));
+        retVal = (FrameMetadata::MAGIC == metadata.magic) && (1 <= metadata.version);
+    }
+    return retVal;
+}
+
+#endif
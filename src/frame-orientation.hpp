@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_ORIENTATION_HPP
+#define FRAME_ORIENTATION_HPP
+
+#include "frame-conversion.hpp"
+#include "frame-layout.hpp"
+
+#include <libyuv.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * FrameOrientation corrects the orientation of captured frames while they are
+ * converted: a frame is first flipped and then rotated clockwise.
+ *
+ * Any combination is reduced to an optional vertical flip followed by a
+ * rotation as a horizontal flip equals a vertical flip followed by a rotation
+ * by 180 degrees. The vertical flip is fused into the conversion by reading
+ * the captured frame bottom-up; rotations convert into a preallocated buffer
+ * in the captured orientation first and rotate from there.
+ */
+class FrameOrientation {
+   private:
+    FrameOrientation(const FrameOrientation &) = delete;
+    FrameOrientation(FrameOrientation &&)      = delete;
+    FrameOrientation &operator=(const FrameOrientation &) = delete;
+    FrameOrientation &operator=(FrameOrientation &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param width Width of the captured frames.
+     * @param height Height of the captured frames.
+     * @param rotation Clockwise rotation in degrees; 0, 90, 180, or 270.
+     * @param flipHorizontally Mirror the captured frames left to right.
+     * @param flipVertically Mirror the captured frames top to bottom.
+     */
+    FrameOrientation(uint32_t width, uint32_t height, uint32_t rotation, bool flipHorizontally, bool flipVertically) noexcept
+        : m_width(width)
+        , m_height(height)
+        , m_rotation((rotation + (flipHorizontally ? 180 : 0)) % 360)
+        , m_flipVertically(flipVertically != flipHorizontally)
+        , m_layoutI420(i420Layout(width, height))
+        , m_layoutGray(grayLayout(width, height))
+        , m_buffer((0 != m_rotation) ? m_layoutI420.size : 0) {}
+
+    /**
+     * @return true if the given rotation is supported.
+     */
+    static bool isValidRotation(uint32_t rotation) noexcept {
+        return (0 == rotation) || (90 == rotation) || (180 == rotation) || (270 == rotation);
+    }
+
+    /**
+     * @return true if the captured frames are published as they are.
+     */
+    bool isIdentity() const noexcept {
+        return (0 == m_rotation) && !m_flipVertically;
+    }
+
+    /**
+     * @return Width of the published frames.
+     */
+    uint32_t width() const noexcept {
+        return ((90 == m_rotation) || (270 == m_rotation)) ? m_height : m_width;
+    }
+
+    /**
+     * @return Height of the published frames.
+     */
+    uint32_t height() const noexcept {
+        return ((90 == m_rotation) || (270 == m_rotation)) ? m_width : m_height;
+    }
+
+    /**
+     * This method converts a captured YUYV422 or RGB24 frame into the I420
+     * frame described by layout, which must have the published width and height.
+     */
+    void convertToI420(const uint8_t *frame, bool isYUYV422, uint8_t *i420, const I420Layout &layout) noexcept {
+        if (0 == m_rotation) {
+            ::convertToI420(frame, isYUYV422, i420, layout, m_flipVertically);
+        }
+        else {
+            uint8_t *buffer{m_buffer.data()};
+            ::convertToI420(frame, isYUYV422, buffer, m_layoutI420, m_flipVertically);
+            libyuv::I420Rotate(buffer + m_layoutI420.offsetY, static_cast<int>(m_layoutI420.strideY),
+                               buffer + m_layoutI420.offsetU, static_cast<int>(m_layoutI420.strideU),
+                               buffer + m_layoutI420.offsetV, static_cast<int>(m_layoutI420.strideV),
+                               i420 + layout.offsetY, static_cast<int>(layout.strideY),
+                               i420 + layout.offsetU, static_cast<int>(layout.strideU),
+                               i420 + layout.offsetV, static_cast<int>(layout.strideV),
+                               static_cast<int>(m_width), static_cast<int>(m_height), rotationMode());
+        }
+    }
+
+    /**
+     * This method extracts the luma of a captured YUYV422 or RGB24 frame into
+     * the grayscale frame described by layout, which must have the published
+     * width and height.
+     */
+    void convertToGray(const uint8_t *frame, bool isYUYV422, uint8_t *gray, const GrayLayout &layout) noexcept {
+        if (0 == m_rotation) {
+            ::convertToGray(frame, isYUYV422, gray, layout, m_flipVertically);
+        }
+        else {
+            uint8_t *buffer{m_buffer.data()};
+            ::convertToGray(frame, isYUYV422, buffer, m_layoutGray, m_flipVertically);
+            libyuv::RotatePlane(buffer, static_cast<int>(m_layoutGray.stride),
+                                gray, static_cast<int>(layout.stride),
+                                static_cast<int>(m_width), static_cast<int>(m_height), rotationMode());
+        }
+    }
+
+   private:
+    libyuv::RotationMode rotationMode() const noexcept {
+        switch (m_rotation) {
+            case 90: return libyuv::kRotate90;
+            case 180: return libyuv::kRotate180;
+            case 270: return libyuv::kRotate270;
+            default: break;
+        }
+        return libyuv::kRotate0;
+    }
+
+   private:
+    const uint32_t m_width;
+    const uint32_t m_height;
+    const uint32_t m_rotation;
+    const bool m_flipVertically;
+    const I420Layout m_layoutI420;
+    const GrayLayout m_layoutGray;
+    std::vector<uint8_t> m_buffer;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include "frame-conversion.hpp"
+#include "frame-layout.hpp"
+#include "frame-orientation.hpp"
+#include "luma-histogram.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * FramePipeline bundles the per-frame work of the conversion thread that
+ * depends on the geometry of the frames: converting a captured frame to I420,
+ * computing the luma statistics, and converting the I420 frame to ARGB.
+ */
+class FramePipeline {
+   private:
+    FramePipeline(const FramePipeline &) = delete;
+    FramePipeline(FramePipeline &&)      = delete;
+    FramePipeline &operator=(const FramePipeline &) = delete;
+    FramePipeline &operator=(FramePipeline &&) = delete;
+
+   public:
+    FramePipeline() = default;
+    virtual ~FramePipeline() = default;
+
+    /**
+     * @return Name of this pipeline for logging.
+     */
+    virtual std::string name() const noexcept = 0;
+
+    virtual void convertToI420(const uint8_t *frame, bool isYUYV422, uint8_t *i420) noexcept = 0;
+    virtual LumaStatistics lumaStatistics(const uint8_t *i420) const noexcept = 0;
+    virtual void convertToARGB(const uint8_t *i420, uint8_t *argb) const noexcept = 0;
+};
+
+/**
+ * Pipeline for any geometry and orientation; layouts are evaluated at runtime.
+ */
+class GenericFramePipeline : public FramePipeline {
+   public:
+    GenericFramePipeline(FrameOrientation &orientation, const I420Layout &layoutI420, const ARGBLayout &layoutARGB) noexcept
+        : FramePipeline()
+        , m_orientation(orientation)
+        , m_layoutI420(layoutI420)
+        , m_layoutARGB(layoutARGB) {}
+
+    std::string name() const noexcept override {
+        return "generic";
+    }
+
+    void convertToI420(const uint8_t *frame, bool isYUYV422, uint8_t *i420) noexcept override {
+        m_orientation.convertToI420(frame, isYUYV422, i420, m_layoutI420);
+    }
+
+    LumaStatistics lumaStatistics(const uint8_t *i420) const noexcept override {
+        return ::lumaStatistics(i420 + m_layoutI420.offsetY, m_layoutI420.strideY, m_layoutI420.width, m_layoutI420.height);
+    }
+
+    void convertToARGB(const uint8_t *i420, uint8_t *argb) const noexcept override {
+        convertI420ToARGB(i420, m_layoutI420, argb, m_layoutARGB);
+    }
+
+   private:
+    FrameOrientation &m_orientation;
+    const I420Layout m_layoutI420;
+    const ARGBLayout m_layoutARGB;
+};
+
+/**
+ * Pipeline for frames of a geometry and layout known at compile time and
+ * without orientation correction: widths, heights, strides, and plane
+ * offsets are constants so that the compiler can drop the layout arithmetic
+ * and the handling of partial rows and blocks from the inlined kernels.
+ */
+template <uint32_t WIDTH, uint32_t HEIGHT, uint32_t STRIDE_ALIGNMENT, uint32_t PLANE_ALIGNMENT>
+class FixedFramePipeline : public FramePipeline {
+   public:
+    static constexpr I420Layout layoutI420() noexcept {
+        return i420Layout(WIDTH, HEIGHT, STRIDE_ALIGNMENT, PLANE_ALIGNMENT);
+    }
+
+    static constexpr ARGBLayout layoutARGB() noexcept {
+        return argbLayout(WIDTH, HEIGHT, STRIDE_ALIGNMENT);
+    }
+
+    std::string name() const noexcept override {
+        return std::to_string(WIDTH) + "x" + std::to_string(HEIGHT) + "/" + std::to_string(STRIDE_ALIGNMENT) + "/" + std::to_string(PLANE_ALIGNMENT);
+    }
+
+    void convertToI420(const uint8_t *frame, bool isYUYV422, uint8_t *i420) noexcept override {
+        constexpr I420Layout LAYOUT{layoutI420()};
+        ::convertToI420(frame, isYUYV422, i420, LAYOUT);
+    }
+
+    LumaStatistics lumaStatistics(const uint8_t *i420) const noexcept override {
+        constexpr I420Layout LAYOUT{layoutI420()};
+        return ::lumaStatistics(i420 + LAYOUT.offsetY, LAYOUT.strideY, WIDTH, HEIGHT);
+    }
+
+    void convertToARGB(const uint8_t *i420, uint8_t *argb) const noexcept override {
+        constexpr I420Layout LAYOUT_I420{layoutI420()};
+        constexpr ARGBLayout LAYOUT_ARGB{layoutARGB()};
+        convertI420ToARGB(i420, LAYOUT_I420, argb, LAYOUT_ARGB);
+    }
+};
+
+/**
+ * @return Fixed pipeline P if its layouts are the given ones, or nullptr otherwise.
+ */
+template <typename P>
+std::unique_ptr<FramePipeline> makeFixedFramePipeline(const I420Layout &layoutI420, const ARGBLayout &layoutARGB) noexcept {
+    constexpr I420Layout LAYOUT_I420{P::layoutI420()};
+    constexpr ARGBLayout LAYOUT_ARGB{P::layoutARGB()};
+    std::unique_ptr<FramePipeline> pipeline;
+    if ( (LAYOUT_I420.width == layoutI420.width) && (LAYOUT_I420.height == layoutI420.height) &&
+         (LAYOUT_I420.strideY == layoutI420.strideY) && (LAYOUT_I420.strideU == layoutI420.strideU) && (LAYOUT_I420.strideV == layoutI420.strideV) &&
+         (LAYOUT_I420.offsetY == layoutI420.offsetY) && (LAYOUT_I420.offsetU == layoutI420.offsetU) && (LAYOUT_I420.offsetV == layoutI420.offsetV) &&
+         (LAYOUT_ARGB.stride == layoutARGB.stride) ) {
+        pipeline.reset(new P());
+    }
+    return pipeline;
+}
+
+/**
+ * @return Fixed pipeline of the given geometry with the packed, aligned, or page-aligned layout matching the given layouts, or nullptr.
+ */
+template <uint32_t WIDTH, uint32_t HEIGHT>
+std::unique_ptr<FramePipeline> makeFixedFramePipeline(const I420Layout &layoutI420, const ARGBLayout &layoutARGB) noexcept {
+    std::unique_ptr<FramePipeline> pipeline{makeFixedFramePipeline<FixedFramePipeline<WIDTH, HEIGHT, 1, 1>>(layoutI420, layoutARGB)};
+    if (!pipeline) {
+        pipeline = makeFixedFramePipeline<FixedFramePipeline<WIDTH, HEIGHT, 64, 64>>(layoutI420, layoutARGB);
+    }
+    if (!pipeline) {
+        pipeline = makeFixedFramePipeline<FixedFramePipeline<WIDTH, HEIGHT, 64, 4096>>(layoutI420, layoutARGB);
+    }
+    return pipeline;
+}
+
+/**
+ * This function selects the pipeline for the given frames: one of the fixed
+ * pipelines for 640x480, 1280x720, and 1920x1080 in any of the layouts
+ * selectable by --layout when the orientation is not corrected, and the
+ * generic one otherwise.
+ *
+ * @param orientation Orientation correction of the captured frames.
+ * @param layoutI420 Layout of the published I420 frames.
+ * @param layoutARGB Layout of the published ARGB frames.
+ * @param generic Use the generic pipeline in any case.
+ */
+inline std::unique_ptr<FramePipeline> makeFramePipeline(FrameOrientation &orientation, const I420Layout &layoutI420, const ARGBLayout &layoutARGB, bool generic = false) noexcept {
+    std::unique_ptr<FramePipeline> pipeline;
+    if (!generic && orientation.isIdentity()) {
+        if ( (640 == layoutI420.width) && (480 == layoutI420.height) ) {
+            pipeline = makeFixedFramePipeline<640, 480>(layoutI420, layoutARGB);
+        }
+        else if ( (1280 == layoutI420.width) && (720 == layoutI420.height) ) {
+            pipeline = makeFixedFramePipeline<1280, 720>(layoutI420, layoutARGB);
+        }
+        else if ( (1920 == layoutI420.width) && (1080 == layoutI420.height) ) {
+            pipeline = makeFixedFramePipeline<1920, 1080>(layoutI420, layoutARGB);
+        }
+    }
+    if (!pipeline) {
+        pipeline.reset(new GenericFramePipeline(orientation, layoutI420, layoutARGB));
+    }
+    return pipeline;
+}
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PLAYER_HPP
+#define FRAME_PLAYER_HPP
+
+#include "cluon-complete.hpp"
+#include "frame-archive.hpp"
+#include "frame-conversion.hpp"
+#include "frame-layout.hpp"
+#include "frame-metadata.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+/**
+ * FramePlayer publishes the frames of a FrameArchive into I420 and ARGB shared
+ * memory areas like the live microservice does. Frames are read directly from
+ * the mapped archive: the I420 frame is copied once into its shared memory area
+ * and the ARGB frame is converted from the archive. The recorded sample time
+ * stamps, flags, and discontinuities are kept; sequence numbers continue across
+ * seeks and the first frame after a seek is flagged as discontinuity, too. The
+ * counter of discontinuities continues from the last published frame after a
+ * seek so that it never decreases, e.g., when starting over with --play-loop.
+ */
+class FramePlayer {
+   private:
+    FramePlayer(const FramePlayer &) = delete;
+    FramePlayer(FramePlayer &&)      = delete;
+    FramePlayer &operator=(const FramePlayer &) = delete;
+    FramePlayer &operator=(FramePlayer &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param archive Archive to play; the layout of sharedMemoryI420 must be the archive's.
+     * @param sharedMemoryI420 Shared memory area to publish the I420 frames in.
+     * @param sharedMemoryARGB Shared memory area to publish the ARGB frames in.
+     * @param layoutARGB Layout of the ARGB frames.
+     */
+    FramePlayer(const FrameArchive &archive, cluon::SharedMemory &sharedMemoryI420, cluon::SharedMemory &sharedMemoryARGB, const ARGBLayout &layoutARGB) noexcept
+        : m_archive(archive)
+        , m_sharedMemoryI420(sharedMemoryI420)
+        , m_sharedMemoryARGB(sharedMemoryARGB)
+        , m_layoutI420(i420Layout(archive.header()))
+        , m_layoutARGB(layoutARGB)
+        , m_position(0)
+        , m_sequenceNumber(0)
+        , m_discontinuities(0)
+        , m_discontinuitiesOffset(0)
+        , m_isDiscontinuity(false)
+        , m_hasStarted(false)
+        , m_start()
+        , m_startSampleTimeStamp(0) {}
+
+    /**
+     * This method continues playing at the first frame that was sampled at or
+     * after the given time stamp.
+     *
+     * @return false if there is no such frame.
+     */
+    bool seek(int64_t sampleTimeStamp) noexcept {
+        m_position = m_archive.find(sampleTimeStamp);
+        m_isDiscontinuity = (0 < m_sequenceNumber);
+        m_hasStarted = false;
+        return m_position < m_archive.header().numberOfFrames;
+    }
+
+    /**
+     * @return Position of the next frame to publish.
+     */
+    uint64_t position() const noexcept {
+        return m_position;
+    }
+
+    /**
+     * This method publishes the next frame; with realTime, it waits until the
+     * frame is due according to the recorded sample time stamps.
+     *
+     * @return false if all frames were published.
+     */
+    bool publishNext(bool realTime) noexcept {
+        if (m_position >= m_archive.header().numberOfFrames) {
+            return false;
+        }
+        const char *slot{m_archive.slot(m_position)};
+        FrameMetadata metadata;
+        readFrameMetadata(slot, m_archive.header().slotSize, metadata);
+        m_archive.prefetch(m_position + 1);
+
+        if (!m_hasStarted) {
+            m_start = std::chrono::steady_clock::now();
+            m_startSampleTimeStamp = metadata.sampleTimeStamp;
+            m_hasStarted = true;
+        }
+        else if (realTime) {
+            std::this_thread::sleep_until(m_start + std::chrono::microseconds(metadata.sampleTimeStamp - m_startSampleTimeStamp));
+        }
+
+        m_sequenceNumber++;
+        metadata.sequenceNumber = m_sequenceNumber;
+        if (m_isDiscontinuity) {
+            metadata.flags |= FrameMetadata::FLAG_DISCONTINUITY;
+            m_discontinuitiesOffset = static_cast<int64_t>(m_discontinuities) + 1 - static_cast<int64_t>(metadata.discontinuities);
+        }
+        m_discontinuities = static_cast<uint32_t>(static_cast<int64_t>(metadata.discontinuities) + m_discontinuitiesOffset);
+        metadata.discontinuities = m_discontinuities;
+        m_isDiscontinuity = false;
+
+        cluon::data::TimeStamp ts{cluon::time::fromMicroseconds(metadata.sampleTimeStamp)};
+        m_sharedMemoryI420.lock();
+        m_sharedMemoryI420.setTimeStamp(ts);
+        {
+            std::memcpy(m_sharedMemoryI420.data(), slot, m_layoutI420.size);
+            metadata.publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+            writeFrameMetadata(m_sharedMemoryI420.data(), m_sharedMemoryI420.size(), metadata);
+        }
+        m_sharedMemoryI420.unlock();
+        m_sharedMemoryI420.notifyAll();
+
+        m_sharedMemoryARGB.lock();
+        m_sharedMemoryARGB.setTimeStamp(ts);
+        {
+            convertI420ToARGB(reinterpret_cast<const uint8_t*>(slot), m_layoutI420, reinterpret_cast<uint8_t*>(m_sharedMemoryARGB.data()), m_layoutARGB);
+            setLayout(metadata, m_layoutARGB);
+            metadata.publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+            writeFrameMetadata(m_sharedMemoryARGB.data(), m_sharedMemoryARGB.size(), metadata);
+        }
+        m_sharedMemoryARGB.unlock();
+        m_sharedMemoryARGB.notifyAll();
+
+        m_position++;
+        return true;
+    }
+
+   private:
+    const FrameArchive &m_archive;
+    cluon::SharedMemory &m_sharedMemoryI420;
+    cluon::SharedMemory &m_sharedMemoryARGB;
+    const I420Layout m_layoutI420;
+    const ARGBLayout m_layoutARGB;
+    uint64_t m_position;
+    uint64_t m_sequenceNumber;
+    uint32_t m_discontinuities;         // Counter of the last published frame.
+    int64_t m_discontinuitiesOffset;   // Added to the recorded counter since the last seek.
+    bool m_isDiscontinuity;
+    bool m_hasStarted;
+    std::chrono::steady_clock::time_point m_start;
+    int64_t m_startSampleTimeStamp;
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_POOL_HPP
+#define FRAME_POOL_HPP
+
+#include "cluon-complete.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+/**
+ * A captured frame residing in a buffer of FramePool.
+ */
+struct Frame {
+    cv::Mat image{};
+    cluon::data::TimeStamp sampleTimeStamp{};
+    bool discontinuity{false}; // Frames were missed before this frame (e.g., the camera was re-opened).
+    int64_t captureTime{0};    // Microseconds on the monotonic clock as reported by FrameSource::captureTime().
+    uint32_t index{0};
+    void *buffer{nullptr};
+};
+
+/**
+ * FramePool holds a fixed number of aligned frame buffers that are allocated
+ * once and handed back and forth between the capturing thread and the
+ * converting thread without any further heap allocation:
+ *
+ * - the capturing thread acquire()s a frame, reads into it, and publish()es it;
+ * - the converting thread take()s the oldest published frame and release()s it.
+ *
+ * If the converting thread falls behind, acquire() reuses the oldest published
+ * frame so that the converting thread always works on the most recent frames;
+ * the frame published after the dropped one is marked as discontinuity.
+ *
+ * A frame of another size or type than expected makes OpenCV reallocate the
+ * frame's cv::Mat; publish() rejects such a frame as it cannot be converted,
+ * restores its preallocated buffer, and marks the next published frame as
+ * discontinuity as well.
+ */
+class FramePool {
+   private:
+    FramePool(const FramePool &) = delete;
+    FramePool(FramePool &&)      = delete;
+    FramePool &operator=(const FramePool &) = delete;
+    FramePool &operator=(FramePool &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param numberOfFrames Number of frames; at least 2.
+     * @param rows Rows of each frame as delivered by the camera.
+     * @param cols Columns of each frame as delivered by the camera.
+     * @param type OpenCV type of each frame as delivered by the camera.
+     * @param alignment Alignment of each frame buffer in bytes.
+     */
+    FramePool(uint32_t numberOfFrames, int32_t rows, int32_t cols, int32_t type, std::size_t alignment = 4096) noexcept
+        : m_frames(numberOfFrames < 2 ? 2 : numberOfFrames)
+        , m_free()
+        , m_published(m_frames.size())
+        , m_publishedHead(0)
+        , m_publishedCount(0)
+        , m_dropped(0)
+        , m_rejected(0)
+        , m_hasMissedFrame(false)
+        , m_rows(rows)
+        , m_cols(cols)
+        , m_type(type)
+        , m_mutex()
+        , m_condition() {
+        const std::size_t SIZE{static_cast<std::size_t>(rows) * static_cast<std::size_t>(cols) * CV_ELEM_SIZE(type)};
+        m_free.reserve(m_frames.size());
+        for (uint32_t i{0}; i < m_frames.size(); i++) {
+            Frame &frame = m_frames[i];
+            frame.index = i;
+            if (0 == ::posix_memalign(&frame.buffer, alignment, SIZE)) {
+                // Touch the buffer once to avoid page faults while capturing.
+                std::memset(frame.buffer, 0, SIZE);
+                frame.image = cv::Mat(rows, cols, type, frame.buffer);
+            }
+            m_free.push_back(i);
+        }
+    }
+
+    ~FramePool() noexcept {
+        for (auto &frame : m_frames) {
+            frame.image.release();
+            ::free(frame.buffer);
+        }
+    }
+
+    /**
+     * @return true if all frame buffers could be allocated.
+     */
+    bool valid() const noexcept {
+        bool retVal{true};
+        for (auto &frame : m_frames) {
+            retVal &= (nullptr != frame.buffer);
+        }
+        return retVal;
+    }
+
+    /**
+     * @return true if the given frame still uses its preallocated buffer; false
+     *         if OpenCV had to reallocate it as the delivered frame had a
+     *         different size or type than expected.
+     */
+    bool usesPreallocatedBuffer(const Frame &frame) const noexcept {
+        return frame.image.data == static_cast<unsigned char*>(frame.buffer);
+    }
+
+    /**
+     * @return Frame to capture into; blocks while all frames are in use.
+     */
+    Frame *acquire() noexcept {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]{ return !m_free.empty() || (0 < m_publishedCount); });
+        uint32_t index{0};
+        if (!m_free.empty()) {
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else {
+            // Drop the oldest published frame that was not yet taken; its successor follows a gap.
+            index = m_published[m_publishedHead];
+            m_publishedHead = (m_publishedHead + 1) % m_published.size();
+            m_publishedCount--;
+            m_dropped++;
+            if (0 < m_publishedCount) {
+                m_frames[m_published[m_publishedHead]].discontinuity = true;
+            }
+            else {
+                m_hasMissedFrame = true;
+            }
+        }
+        return &m_frames[index];
+    }
+
+    /**
+     * This method hands a captured frame over to the converting thread.
+     *
+     * @return true if the frame was published; false if it was rejected as it
+     *         does not use its preallocated buffer anymore.
+     */
+    bool publish(Frame *frame) noexcept {
+        const bool IS_PREALLOCATED{usesPreallocatedBuffer(*frame)};
+        if (!IS_PREALLOCATED) {
+            // Releases OpenCV's buffer.
+            frame->image = cv::Mat(m_rows, m_cols, m_type, frame->buffer);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (IS_PREALLOCATED) {
+                frame->discontinuity |= m_hasMissedFrame;
+                m_hasMissedFrame = false;
+                m_published[(m_publishedHead + m_publishedCount) % m_published.size()] = frame->index;
+                m_publishedCount++;
+            }
+            else {
+                m_hasMissedFrame = true;
+                m_rejected++;
+                m_free.push_back(frame->index);
+            }
+        }
+        m_condition.notify_all();
+        return IS_PREALLOCATED;
+    }
+
+    /**
+     * @return Oldest published frame or nullptr if none was published within timeout.
+     */
+    Frame *take(std::chrono::milliseconds timeout) noexcept {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Frame *frame{nullptr};
+        if (m_condition.wait_for(lock, timeout, [this]{ return (0 < m_publishedCount); })) {
+            frame = &m_frames[m_published[m_publishedHead]];
+            m_publishedHead = (m_publishedHead + 1) % m_published.size();
+            m_publishedCount--;
+        }
+        return frame;
+    }
+
+    /**
+     * This method returns a frame to the pool of free frames.
+     */
+    void release(Frame *frame) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(frame->index);
+        }
+        m_condition.notify_all();
+    }
+
+    /**
+     * @return Number of frames that were dropped as the converting thread fell behind.
+     */
+    uint64_t dropped() noexcept {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropped;
+    }
+
+    /**
+     * @return Number of frames that were rejected as they had another size or type than expected.
+     */
+    uint64_t rejected() noexcept {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_rejected;
+    }
+
+   private:
+    std::vector<Frame> m_frames;
+    std::vector<uint32_t> m_free;
+    std::vector<uint32_t> m_published;
+    std::size_t m_publishedHead;
+    std::size_t m_publishedCount;
+    uint64_t m_dropped;
+    uint64_t m_rejected;
+    bool m_hasMissedFrame;
+    const int32_t m_rows;
+    const int32_t m_cols;
+    const int32_t m_type;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_RECORDER_HPP
+#define FRAME_RECORDER_HPP
+
+#include "cluon-complete.hpp"
+#include "frame-archive.hpp"
+#include "frame-metadata.hpp"
+#include "realtime-scheduling.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+/**
+ * FrameRecorder appends the frames published in an I420 shared memory area to
+ * a FrameArchive from a separate thread: the converting thread only signals
+ * a new frame. The recorder prefaults the next slot of the archive, copies the
+ * frame while holding the shared memory's lock like any other consumer, and
+ * starts writing the slot back to disk without waiting for it.
+ *
+ * Frames that were published while the recorder was still busy with a
+ * previous frame are counted as dropped.
+ */
+class FrameRecorder {
+   private:
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder(FrameRecorder &&)      = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(FrameRecorder &&) = delete;
+
+   public:
+    FrameRecorder(FrameArchive &archive, cluon::SharedMemory &sharedMemoryI420) noexcept
+        : m_archive(archive)
+        , m_sharedMemoryI420(sharedMemoryI420)
+        , m_mutex()
+        , m_condition()
+        , m_published(0)
+        , m_running(true)
+        , m_recorded(0)
+        , m_dropped(0)
+        , m_thread() {
+        m_thread = std::thread(&FrameRecorder::run, this);
+    }
+
+    ~FrameRecorder() noexcept {
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_running = false;
+        }
+        m_condition.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    /**
+     * This method signals that a new frame was published.
+     */
+    void notify() noexcept {
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_published++;
+        }
+        m_condition.notify_one();
+    }
+
+    uint64_t recorded() noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        return m_recorded;
+    }
+
+    uint64_t dropped() noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        return m_dropped;
+    }
+
+   private:
+    void run() noexcept {
+        FrameArchiveHeader &header{m_archive.header()};
+        const I420Layout LAYOUT{i420Layout(header)};
+        uint64_t handled{0};
+        uint64_t lastSequenceNumber{0};
+        bool hasReportedFullArchive{false};
+        FrameMetadata metadata;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(m_mutex);
+                m_condition.wait(lck, [this, handled]{ return !m_running || (m_published != handled); });
+                if (!m_running) {
+                    break;
+                }
+                handled = m_published;
+            }
+
+            const uint64_t SLOT{header.numberOfFrames};
+            if (SLOT >= header.capacity) {
+                if (!hasReportedFullArchive) {
+                    std::cerr << "[opendlv-device-camera-opencv]: Archive is full after " << SLOT << " frames; further frames are not recorded." << std::endl;
+                    hasReportedFullArchive = true;
+                }
+                std::lock_guard<std::mutex> lck(m_mutex);
+                m_dropped++;
+                continue;
+            }
+
+            // Take the page faults of the slot before copying while holding the lock.
+            char *slot{m_archive.slot(SLOT)};
+            prefault(slot, header.slotSize);
+
+            bool hasFrame{false};
+            m_sharedMemoryI420.lock();
+            {
+                if (readFrameMetadata(m_sharedMemoryI420.data(), m_sharedMemoryI420.size(), metadata) && (metadata.sequenceNumber != lastSequenceNumber)) {
+                    std::memcpy(slot, m_sharedMemoryI420.data(), LAYOUT.size);
+                    hasFrame = true;
+                }
+            }
+            m_sharedMemoryI420.unlock();
+            if (!hasFrame) {
+                continue;
+            }
+
+            writeFrameMetadata(slot, header.slotSize, metadata);
+            FrameArchiveIndexEntry &entry{m_archive.indexEntry(SLOT)};
+            entry.sampleTimeStamp = metadata.sampleTimeStamp;
+            entry.sequenceNumber = metadata.sequenceNumber;
+            entry.filePosition = header.dataOffset + SLOT * header.slotSize;
+            // The frame is complete; a reader stopping here sees a consistent archive.
+            header.numberOfFrames = SLOT + 1;
+            m_archive.writeBack(SLOT);
+
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_dropped += ( (0 < lastSequenceNumber) && (metadata.sequenceNumber > lastSequenceNumber + 1) ) ? metadata.sequenceNumber - lastSequenceNumber - 1 : 0;
+            m_recorded++;
+            lastSequenceNumber = metadata.sequenceNumber;
+        }
+    }
+
+   private:
+    FrameArchive &m_archive;
+    cluon::SharedMemory &m_sharedMemoryI420;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    uint64_t m_published;
+    bool m_running;
+    uint64_t m_recorded;
+    uint64_t m_dropped;
+    std::thread m_thread;
+};
+
+#endif
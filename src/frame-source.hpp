@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SOURCE_HPP
+#define FRAME_SOURCE_HPP
+
+#include "frame-layout.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+/**
+ * A FrameSource delivers frames in the format expected by the frame pool:
+ * YUYV422 as one row of bytes or RGB24 (i.e., OpenCV's BGR) with one row per
+ * image row. All methods are called from the capturing thread only.
+ */
+class FrameSource {
+   private:
+    FrameSource(const FrameSource &) = delete;
+    FrameSource(FrameSource &&)      = delete;
+    FrameSource &operator=(const FrameSource &) = delete;
+    FrameSource &operator=(FrameSource &&) = delete;
+
+   public:
+    FrameSource() = default;
+    virtual ~FrameSource() = default;
+
+    /**
+     * This method (re-)opens the source.
+     *
+     * @return true if the source could be opened.
+     */
+    virtual bool open() noexcept = 0;
+    virtual bool isOpened() noexcept = 0;
+    virtual void release() noexcept = 0;
+
+    /**
+     * This method reads the next frame into image.
+     *
+     * @return true if a frame was read.
+     */
+    virtual bool read(cv::Mat &image) noexcept = 0;
+
+    /**
+     * @return true if the given cv::CAP_PROP_* property was accepted.
+     */
+    virtual bool set(int property, double value) noexcept {
+        (void)property;
+        (void)value;
+        return false;
+    }
+
+    /**
+     * @return Value of the given cv::CAP_PROP_* property or 0 if unknown.
+     */
+    virtual double get(int property) noexcept {
+        (void)property;
+        return 0.0;
+    }
+
+    /**
+     * This method is called right after a successful read().
+     *
+     * @return Capture time of the last frame in microseconds on the monotonic
+     *         clock (std::chrono::steady_clock); sources without a driver time
+     *         stamp return the time of reception.
+     */
+    virtual int64_t captureTime() noexcept {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+/**
+ * @return true if camera is the address of a network stream (e.g., rtsp://...).
+ */
+inline bool isNetworkStream(const std::string &camera) noexcept {
+    return std::string::npos != camera.find("://");
+}
+
+/**
+ * StreamLatency estimates the latency of a network stream from the
+ * presentation time stamps of its frames. Without a common clock, only the
+ * latency above the lowest one observed so far can be determined; this is
+ * the part that is added by buffering in the network, the decoder, or here.
+ */
+class StreamLatency {
+   public:
+    /**
+     * This method adds a frame with the given presentation time stamp that was
+     * received at the given time.
+     */
+    void add(double ptsInMilliseconds, std::chrono::steady_clock::time_point received) noexcept {
+        const double OFFSET{std::chrono::duration<double, std::milli>(received.time_since_epoch()).count() - ptsInMilliseconds};
+        // Start over when the stream was restarted, i.e., its time stamps jumped backwards.
+        if ( (0 == m_frames) || (ptsInMilliseconds < m_lastPts) ) {
+            m_minOffset = OFFSET;
+        }
+        m_minOffset = std::min(m_minOffset, OFFSET);
+        const double LATENCY{OFFSET - m_minOffset};
+        m_sum += LATENCY;
+        m_max = std::max(m_max, LATENCY);
+        m_lastPts = ptsInMilliseconds;
+        m_frames++;
+        m_framesInPeriod++;
+    }
+
+    /**
+     * @return Mean latency in milliseconds above the minimum since the last call to reset().
+     */
+    double mean() const noexcept {
+        return (0 < m_framesInPeriod) ? m_sum / static_cast<double>(m_framesInPeriod) : 0.0;
+    }
+
+    /**
+     * @return Maximum latency in milliseconds above the minimum since the last call to reset().
+     */
+    double max() const noexcept {
+        return m_max;
+    }
+
+    void reset() noexcept {
+        m_sum = m_max = 0.0;
+        m_framesInPeriod = 0;
+    }
+
+   private:
+    double m_minOffset{0.0};
+    double m_lastPts{0.0};
+    double m_sum{0.0};
+    double m_max{0.0};
+    uint64_t m_frames{0};
+    uint64_t m_framesInPeriod{0};
+};
+
+/**
+ * This function grabs frames of a network stream until the newest one was
+ * reached: a frame that is grabbed much faster than the frame period was
+ * already queued and is skipped in favour of the next one until a grab has to
+ * wait for the network. FFmpeg ignores cv::CAP_PROP_BUFFERSIZE, so draining
+ * is the only way to bound the queue's latency.
+ *
+ * @param grab Callable grabbing the next frame and returning false on failure.
+ * @param freq Frame rate of the stream.
+ * @param drainedFrames Counter of skipped frames.
+ * @return true if the newest frame was grabbed.
+ */
+template <typename Grab>
+bool grabNewestFrame(Grab &&grab, float freq, uint64_t &drainedFrames) noexcept {
+    const auto THRESHOLD{std::chrono::duration<double>(0.25 / static_cast<double>(freq))};
+    constexpr uint32_t MAX_DRAINED_FRAMES{30};
+    for (uint32_t i{0}; ; i++) {
+        const auto BEFORE{std::chrono::steady_clock::now()};
+        if (!grab()) {
+            return false;
+        }
+        if ( (std::chrono::steady_clock::now() - BEFORE > THRESHOLD) || (MAX_DRAINED_FRAMES == i) ) {
+            return true;
+        }
+        drainedFrames++;
+    }
+}
+
+/**
+ * OpenCVFrameSource delivers frames from a cv::VideoCapture.
+ *
+ * Network streams are opened with FFmpeg's low-delay options; as FFmpeg
+ * still queues the frames that arrived while a frame was processed, read()
+ * drains these queued frames and delivers the newest one.
+ */
+class OpenCVFrameSource : public FrameSource {
+   public:
+    /**
+     * Constructor.
+     *
+     * @param camera V4L identifier or stream address.
+     * @param width Desired width of a frame.
+     * @param height Desired height of a frame.
+     * @param freq Desired frame rate.
+     * @param isYUYV422 true to receive raw YUYV422 frames.
+     * @param timeout Timeout for opening and reading in milliseconds for backends that support it.
+     */
+    OpenCVFrameSource(const std::string &camera, uint32_t width, uint32_t height, float freq, bool isYUYV422, int32_t timeout) noexcept
+        : m_camera(camera)
+        , m_width(width)
+        , m_height(height)
+        , m_freq(freq)
+        , m_isYUYV422(isYUYV422)
+        , m_timeout(timeout)
+        , m_isNetworkStream(isNetworkStream(camera))
+        , m_capture()
+        , m_streamLatency()
+        , m_drainedFrames(0)
+        , m_captureTime(0) {}
+
+    bool open() noexcept override {
+        try {
+            m_capture.release();
+            if (m_isNetworkStream) {
+                // Options for FFmpeg's demuxer and decoder to not buffer or reorder
+                // frames; options given in the environment take precedence.
+                ::setenv("OPENCV_FFMPEG_CAPTURE_OPTIONS", "fflags;nobuffer|flags;low_delay|max_delay;0|reorder_queue_size;0|rtsp_transport;tcp", 0);
+            }
+            const int API{m_isNetworkStream ? cv::CAP_FFMPEG : cv::CAP_ANY};
+#if (CV_VERSION_MAJOR > 4) || ((CV_VERSION_MAJOR == 4) && ((CV_VERSION_MINOR > 5) || ((CV_VERSION_MINOR == 5) && (CV_VERSION_REVISION >= 2))))
+            m_capture.open(m_camera, API, {cv::CAP_PROP_OPEN_TIMEOUT_MSEC, m_timeout, cv::CAP_PROP_READ_TIMEOUT_MSEC, m_timeout});
+#else
+            m_capture.open(m_camera, API);
+#endif
+            if (m_capture.isOpened() && !m_isNetworkStream) {
+                m_capture.set(cv::CAP_PROP_FRAME_WIDTH, m_width);
+                m_capture.set(cv::CAP_PROP_FRAME_HEIGHT, m_height);
+                m_capture.set(cv::CAP_PROP_FPS, static_cast<uint32_t>(m_freq));
+
+                // Avoid using OpenCV for tranforming incoming frame to RGB as this is expensive.
+                if (m_isYUYV422) {
+                    m_capture.set(cv::CAP_PROP_CONVERT_RGB, false);
+                }
+            }
+            return m_capture.isOpened();
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    bool isOpened() noexcept override {
+        return m_capture.isOpened();
+    }
+
+    void release() noexcept override {
+        try {
+            m_capture.release();
+        }
+        catch (...) {}
+    }
+
+    bool read(cv::Mat &image) noexcept override {
+        try {
+            if (!m_isNetworkStream) {
+                const bool RETVAL{m_capture.read(image)};
+                // V4L2 reports the driver's time stamp of the buffer on the monotonic clock
+                // as position; other backends report something else, which is discarded.
+                const int64_t NOW{FrameSource::captureTime()};
+                const int64_t DRIVER{static_cast<int64_t>(m_capture.get(cv::CAP_PROP_POS_MSEC) * 1000.0)};
+                m_captureTime = ( (DRIVER > NOW - 1000 * 1000) && (DRIVER <= NOW) ) ? DRIVER : NOW;
+                return RETVAL;
+            }
+
+            if (!grabNewestFrame([this]() { return m_capture.grab(); }, m_freq, m_drainedFrames)) {
+                return false;
+            }
+            m_streamLatency.add(m_capture.get(cv::CAP_PROP_POS_MSEC), std::chrono::steady_clock::now());
+            return m_capture.retrieve(image);
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    bool set(int property, double value) noexcept override {
+        try {
+            return m_capture.set(property, value);
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    double get(int property) noexcept override {
+        try {
+            return m_capture.get(property);
+        }
+        catch (...) {
+            return 0.0;
+        }
+    }
+
+    int64_t captureTime() noexcept override {
+        return m_isNetworkStream ? FrameSource::captureTime() : m_captureTime;
+    }
+
+    /**
+     * @return Latency estimate for network streams.
+     */
+    StreamLatency &streamLatency() noexcept {
+        return m_streamLatency;
+    }
+
+    /**
+     * @return Number of frames that were skipped to reach the newest frame of a network stream.
+     */
+    uint64_t drainedFrames() const noexcept {
+        return m_drainedFrames;
+    }
+
+   private:
+    const std::string m_camera;
+    const uint32_t m_width;
+    const uint32_t m_height;
+    const float m_freq;
+    const bool m_isYUYV422;
+    const int32_t m_timeout;
+    const bool m_isNetworkStream;
+    cv::VideoCapture m_capture;
+    StreamLatency m_streamLatency;
+    uint64_t m_drainedFrames;
+    int64_t m_captureTime;
+};
+
+/**
+ * SyntheticFrameSource delivers a moving test pattern at the given frame rate
+ * without any camera. Faults can be injected from any thread to simulate a
+ * camera that disappears (e.g., after a USB reset) and reappears after a given
+ * number of attempts to re-open it; the first frame can be delayed to simulate
+ * a camera that is slow to start.
+ */
+class SyntheticFrameSource : public FrameSource {
+   public:
+    SyntheticFrameSource(uint32_t width, uint32_t height, float freq, bool isYUYV422) noexcept
+        : m_period(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / static_cast<double>(freq))))
+        , m_pattern(isYUYV422 ? cv::Mat(1, static_cast<int32_t>(yuyv422Stride(width) * height), CV_8UC1) : cv::Mat(static_cast<int32_t>(height), static_cast<int32_t>(width), CV_8UC3))
+        , m_rowSize(isYUYV422 ? yuyv422Stride(width) : rgb24Stride(width))
+        , m_height(height)
+        , m_isOpened(false)
+        , m_nextFrame()
+        , m_firstFrameDelay(0)
+        , m_firstFrame()
+        , m_frameCounter(0)
+        , m_faulty(false)
+        , m_failingOpens(0) {
+        uint8_t *data{m_pattern.data};
+        for (uint32_t y{0}; y < height; y++) {
+            for (uint32_t x{0}; x < m_rowSize; x++) {
+                data[static_cast<std::size_t>(y) * m_rowSize + x] = static_cast<uint8_t>((x + 2 * y) & 0xFF);
+            }
+        }
+    }
+
+    /**
+     * This method lets reads fail from now on until the source was re-opened
+     * successfully; the next failingOpens attempts to re-open fail.
+     */
+    void injectFault(uint32_t failingOpens) noexcept {
+        m_failingOpens.store(failingOpens);
+        m_faulty.store(true);
+    }
+
+    /**
+     * This method lets reads fail for the given time after the next successful
+     * open(); it must be called before opening the source.
+     */
+    void delayFirstFrame(std::chrono::milliseconds delay) noexcept {
+        m_firstFrameDelay = delay;
+    }
+
+    bool open() noexcept override {
+        if (0 < m_failingOpens.load()) {
+            m_failingOpens--;
+            return false;
+        }
+        m_faulty.store(false);
+        m_isOpened = true;
+        m_firstFrame = std::chrono::steady_clock::now() + m_firstFrameDelay;
+        m_nextFrame = m_firstFrame;
+        m_firstFrameDelay = std::chrono::milliseconds(0);
+        return true;
+    }
+
+    bool isOpened() noexcept override {
+        return m_isOpened;
+    }
+
+    void release() noexcept override {
+        m_isOpened = false;
+    }
+
+    bool read(cv::Mat &image) noexcept override {
+        if (!m_isOpened || m_faulty.load() || (std::chrono::steady_clock::now() < m_firstFrame)) {
+            return false;
+        }
+        std::this_thread::sleep_until(m_nextFrame);
+        m_nextFrame += m_period;
+
+        // Copying into image does not allocate when image has the pattern's size and type.
+        m_pattern.copyTo(image);
+        // Move a bright bar downwards and stamp the frame counter into the first row.
+        const uint32_t ROW{static_cast<uint32_t>(m_frameCounter % m_height)};
+        std::memset(image.data + static_cast<std::size_t>(ROW) * m_rowSize, 0xEB, m_rowSize);
+        std::memcpy(image.data, &m_frameCounter, std::min<std::size_t>(sizeof(m_frameCounter), m_rowSize));
+        m_frameCounter++;
+        return true;
+    }
+
+    bool set(int property, double value) noexcept override {
+        if (cv::CAP_PROP_FPS == property && (value > 0.0)) {
+            m_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / value));
+            return true;
+        }
+        return false;
+    }
+
+    double get(int property) noexcept override {
+        return (cv::CAP_PROP_FPS == property) ? 1.0 / std::chrono::duration<double>(m_period).count() : 0.0;
+    }
+
+   private:
+    std::chrono::steady_clock::duration m_period;
+    cv::Mat m_pattern;
+    const uint32_t m_rowSize;
+    const uint32_t m_height;
+    bool m_isOpened;
+    std::chrono::steady_clock::time_point m_nextFrame;
+    std::chrono::milliseconds m_firstFrameDelay;
+    std::chrono::steady_clock::time_point m_firstFrame;
+    uint64_t m_frameCounter;
+    std::atomic<bool> m_faulty;
+    std::atomic<uint32_t> m_failingOpens;
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SYNCHRONIZER_HPP
+#define FRAME_SYNCHRONIZER_HPP
+
+#include "frame-pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * FrameSynchronizer combines the frames of several cameras, each captured by
+ * its own thread into its own FramePool, into sets of one frame per camera
+ * whose capture times are at most the tolerance apart.
+ *
+ * The oldest frame of each pool is held as candidate. While the candidates
+ * are further apart than the tolerance, the earliest one cannot belong to any
+ * later set either and is discarded in favour of the next frame of its camera.
+ * As the pools drop their oldest frames when the conversion falls behind, a
+ * camera that stalls does not hold back the others for longer than until its
+ * next frame arrives.
+ *
+ * Consumers see these gaps as discontinuities: frames dropped by a pool mark
+ * the next frame of their camera (cf. FramePool), and a candidate discarded
+ * after the first set marks the next set as discontinuity.
+ */
+class FrameSynchronizer {
+   private:
+    FrameSynchronizer(const FrameSynchronizer &) = delete;
+    FrameSynchronizer(FrameSynchronizer &&)      = delete;
+    FrameSynchronizer &operator=(const FrameSynchronizer &) = delete;
+    FrameSynchronizer &operator=(FrameSynchronizer &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param pools Frame pools of the cameras; they must outlive this object.
+     * @param tolerance Maximum difference between the capture times of a set in microseconds.
+     */
+    FrameSynchronizer(const std::vector<FramePool*> &pools, int64_t tolerance) noexcept
+        : m_pools(pools)
+        , m_candidates(pools.size(), nullptr)
+        , m_tolerance(tolerance)
+        , m_spread(0)
+        , m_discarded(0)
+        , m_hasTakenSet(false)
+        , m_hasDiscardedFrame(false) {}
+
+    ~FrameSynchronizer() noexcept {
+        release(m_candidates);
+    }
+
+    /**
+     * This method waits for the next complete set of frames; frames in set
+     * are ordered like the pools and must be handed back with release().
+     *
+     * @param set Frames of the set.
+     * @param timeout Maximum time to wait for a frame of any camera.
+     * @return true if a set is available; false if a camera did not deliver within timeout.
+     */
+    bool take(std::vector<Frame*> &set, std::chrono::milliseconds timeout) noexcept {
+        while (true) {
+            for (std::size_t i{0}; i < m_pools.size(); i++) {
+                if (nullptr == m_candidates[i]) {
+                    m_candidates[i] = m_pools[i]->take(timeout);
+                    if (nullptr == m_candidates[i]) {
+                        return false;
+                    }
+                }
+            }
+            std::size_t earliest{0};
+            std::size_t latest{0};
+            for (std::size_t i{1}; i < m_candidates.size(); i++) {
+                earliest = (m_candidates[i]->captureTime < m_candidates[earliest]->captureTime) ? i : earliest;
+                latest = (m_candidates[i]->captureTime > m_candidates[latest]->captureTime) ? i : latest;
+            }
+            const int64_t SPREAD{m_candidates[latest]->captureTime - m_candidates[earliest]->captureTime};
+            if (SPREAD <= m_tolerance) {
+                m_spread = SPREAD;
+                m_candidates[earliest]->discontinuity |= m_hasDiscardedFrame;
+                m_hasDiscardedFrame = false;
+                m_hasTakenSet = true;
+                set.assign(m_candidates.begin(), m_candidates.end());
+                std::fill(m_candidates.begin(), m_candidates.end(), nullptr);
+                return true;
+            }
+            // Before the first set, discarding only aligns the cameras.
+            m_hasDiscardedFrame |= m_hasTakenSet;
+            m_pools[earliest]->release(m_candidates[earliest]);
+            m_candidates[earliest] = nullptr;
+            m_discarded++;
+        }
+    }
+
+    /**
+     * This method hands the frames of a set back to their pools.
+     */
+    void release(std::vector<Frame*> &set) noexcept {
+        for (std::size_t i{0}; i < set.size(); i++) {
+            if (nullptr != set[i]) {
+                m_pools[i]->release(set[i]);
+                set[i] = nullptr;
+            }
+        }
+    }
+
+    /**
+     * @return Microseconds between the earliest and latest capture time of the last set.
+     */
+    int64_t spread() const noexcept {
+        return m_spread;
+    }
+
+    /**
+     * @return Number of frames that were discarded as no other camera had a frame close enough.
+     */
+    uint64_t discarded() const noexcept {
+        return m_discarded;
+    }
+
+   private:
+    std::vector<FramePool*> m_pools;
+    std::vector<Frame*> m_candidates;
+    const int64_t m_tolerance;
+    int64_t m_spread;
+    uint64_t m_discarded;
+    bool m_hasTakenSet;
+    bool m_hasDiscardedFrame;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUGE_PAGES_HPP
+#define HUGE_PAGES_HPP
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// cluon::SharedMemory creates its areas itself (SysV shmget by default, POSIX
+// shm_open with CLUON_SHAREDMEMORY_POSIX=1) and hence, huge pages cannot be
+// requested via SHM_HUGETLB or MAP_HUGETLB without breaking the naming that
+// consumers rely on. Instead, the areas are advised to be backed by transparent
+// huge pages, which requires /sys/kernel/mm/transparent_hugepage/shmem_enabled
+// to be advise, within_size, or always (SysV) or /dev/shm to be mounted with
+// huge=advise or similar (POSIX). Consumers attaching to such an area map the
+// same huge pages.
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
+constexpr uint32_t HUGE_PAGE_SIZE{2 * 1024 * 1024};
+
+/**
+ * @return Page-aligned begin of the given memory.
+ */
+inline char *pageBegin(char *data) noexcept {
+    const uintptr_t PAGE_SIZE_MASK{~(static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE)) - 1)};
+    return reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(data) & PAGE_SIZE_MASK);
+}
+
+/**
+ * @return size rounded up to the next multiple of the huge page size.
+ */
+inline uint32_t roundUpToHugePages(uint32_t size) noexcept {
+    return ((size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+}
+
+/**
+ * This function advises the kernel to back the pages of the given memory,
+ * which is not yet touched, with transparent huge pages.
+ *
+ * @return true if the advice was accepted.
+ */
+inline bool adviseHugePages(char *data, uint32_t size) noexcept {
+#ifdef MADV_HUGEPAGE
+    char *begin{pageBegin(data)};
+    return (0 == ::madvise(begin, static_cast<std::size_t>((data + size) - begin), MADV_HUGEPAGE));
+#else
+    (void)data;
+    (void)size;
+    return false;
+#endif
+}
+
+/**
+ * This function asks the kernel to collapse the already touched pages of the
+ * given memory into huge pages (Linux 6.1 or newer).
+ *
+ * @return true if the pages could be collapsed.
+ */
+inline bool collapseHugePages(char *data, uint32_t size) noexcept {
+    char *begin{pageBegin(data)};
+    return (0 == ::madvise(begin, static_cast<std::size_t>((data + size) - begin), MADV_COLLAPSE));
+}
+
+/**
+ * @return Number of bytes of the mapping containing data that are mapped by huge pages.
+ */
+inline uint64_t hugePageBackedBytes(const char *data) noexcept {
+    uint64_t retVal{0};
+    const uintptr_t ADDRESS{reinterpret_cast<uintptr_t>(data)};
+    std::ifstream smaps("/proc/self/smaps");
+    bool isMapping{false};
+    std::string line;
+    while (std::getline(smaps, line)) {
+        uintptr_t begin{0};
+        uintptr_t end{0};
+        char dash{0};
+        std::stringstream sstr(line);
+        // Header lines of a mapping look like "7f0000000000-7f0000200000 rw-s ...".
+        if ( (sstr >> std::hex >> begin >> dash >> end) && ('-' == dash) ) {
+            isMapping = (begin <= ADDRESS) && (ADDRESS < end);
+        }
+        else if (isMapping) {
+            std::string key;
+            uint64_t kilobytes{0};
+            std::stringstream entry(line);
+            if ( (entry >> key >> kilobytes) && ( ("ShmemPmdMapped:" == key) || ("FilePmdMapped:" == key) ) ) {
+                retVal += kilobytes * 1024;
+            }
+        }
+    }
+    return retVal;
+}
+
+#endif
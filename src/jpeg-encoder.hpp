@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JPEG_ENCODER_HPP
+#define JPEG_ENCODER_HPP
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "frame-layout.hpp"
+#include "frame-metadata.hpp"
+
+#include <libyuv.h>
+#ifdef HAVE_TURBOJPEG
+    #include <turbojpeg.h>
+#else
+    #include <opencv2/core/core.hpp>
+    #include <opencv2/imgcodecs/imgcodecs.hpp>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * JpegCompressor compresses I420 frames into JPEG images of at most maxSize
+ * bytes. A frame that does not fit is compressed again with the quality
+ * lowered in steps of 10 down to 30 and then at half the width and height
+ * with the requested quality, down to an eighth. The quality and scale found
+ * are kept for the next frames. After 30 frames in a row of less than half of
+ * maxSize, the quality is raised again; at the requested quality, the scale is
+ * doubled again after 30 frames of less than a quarter of maxSize.
+ *
+ * The I420 planes are compressed directly with TurboJPEG when available;
+ * otherwise, they are converted to BGR and compressed with OpenCV.
+ */
+class JpegCompressor {
+   private:
+    JpegCompressor(const JpegCompressor &) = delete;
+    JpegCompressor(JpegCompressor &&)      = delete;
+    JpegCompressor &operator=(const JpegCompressor &) = delete;
+    JpegCompressor &operator=(JpegCompressor &&) = delete;
+
+    static constexpr int32_t MIN_QUALITY{30};
+    static constexpr int32_t QUALITY_STEP{10};
+    static constexpr uint32_t MAX_SCALE{8};
+    static constexpr uint32_t FRAMES_BEFORE_RAISING{30};
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param layout Layout of the I420 frames.
+     * @param quality Requested JPEG quality between 1 and 100.
+     * @param maxSize Maximum size of a compressed frame in bytes.
+     */
+    JpegCompressor(const I420Layout &layout, int32_t quality, uint32_t maxSize) noexcept
+        : m_layout(layout)
+        , m_scaledLayout(layout)
+        , m_requestedQuality(quality)
+        , m_maxSize(maxSize)
+        , m_quality(quality)
+        , m_scale(1)
+        , m_smallFrames(0)
+        , m_scaled(i420Layout((layout.width + 1) / 2, (layout.height + 1) / 2).size)
+#ifdef HAVE_TURBOJPEG
+        , m_handle(tjInitCompress())
+        , m_jpeg(tjBufSize(static_cast<int>(layout.width), static_cast<int>(layout.height), TJSAMP_420))
+#else
+        , m_bgr(static_cast<int>(layout.height), static_cast<int>(layout.width), CV_8UC3)
+        , m_jpeg()
+#endif
+    {}
+
+    ~JpegCompressor() noexcept {
+#ifdef HAVE_TURBOJPEG
+        if (nullptr != m_handle) {
+            tjDestroy(m_handle);
+        }
+#endif
+    }
+
+    /**
+     * @return Name of the JPEG implementation in use.
+     */
+    static const char *backend() noexcept {
+#ifdef HAVE_TURBOJPEG
+        return "TurboJPEG";
+#else
+        return "OpenCV";
+#endif
+    }
+
+    /**
+     * This method compresses the given I420 frame; the compressed frame stays
+     * valid until the next call.
+     *
+     * @param i420 Frame in the layout given to the constructor.
+     * @param jpeg Compressed frame.
+     * @param jpegSize Size of the compressed frame; larger than maxSize if it
+     *        did not fit even at the lowest quality and scale.
+     * @return false if the frame could not be compressed.
+     */
+    bool compress(const uint8_t *i420, const uint8_t *&jpeg, uint32_t &jpegSize) noexcept {
+        while (true) {
+            const uint8_t *frame{i420};
+            if (1 < m_scale) {
+                libyuv::I420Scale(i420 + m_layout.offsetY, static_cast<int>(m_layout.strideY),
+                                  i420 + m_layout.offsetU, static_cast<int>(m_layout.strideU),
+                                  i420 + m_layout.offsetV, static_cast<int>(m_layout.strideV),
+                                  static_cast<int>(m_layout.width), static_cast<int>(m_layout.height),
+                                  m_scaled.data() + m_scaledLayout.offsetY, static_cast<int>(m_scaledLayout.strideY),
+                                  m_scaled.data() + m_scaledLayout.offsetU, static_cast<int>(m_scaledLayout.strideU),
+                                  m_scaled.data() + m_scaledLayout.offsetV, static_cast<int>(m_scaledLayout.strideV),
+                                  static_cast<int>(m_scaledLayout.width), static_cast<int>(m_scaledLayout.height),
+                                  libyuv::kFilterBox);
+                frame = m_scaled.data();
+            }
+            if (!encode(frame, jpeg, jpegSize)) {
+                return false;
+            }
+            if (jpegSize <= m_maxSize) {
+                raise(jpegSize);
+                return true;
+            }
+            m_smallFrames = 0;
+            if (MIN_QUALITY < m_quality) {
+                m_quality = std::max(int32_t{MIN_QUALITY}, m_quality - QUALITY_STEP);
+            }
+            else if (MAX_SCALE > m_scale) {
+                setScale(m_scale * 2);
+                m_quality = m_requestedQuality;
+            }
+            else {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * @return Width of the compressed frames.
+     */
+    uint32_t width() const noexcept {
+        return m_scaledLayout.width;
+    }
+
+    /**
+     * @return Height of the compressed frames.
+     */
+    uint32_t height() const noexcept {
+        return m_scaledLayout.height;
+    }
+
+    /**
+     * @return Quality in use.
+     */
+    int32_t quality() const noexcept {
+        return m_quality;
+    }
+
+   private:
+    void raise(uint32_t jpegSize) noexcept {
+        const bool IS_SMALL{(m_quality < m_requestedQuality) ? (jpegSize < m_maxSize / 2) : ((1 < m_scale) && (jpegSize < m_maxSize / 4))};
+        m_smallFrames = IS_SMALL ? m_smallFrames + 1 : 0;
+        if (FRAMES_BEFORE_RAISING <= m_smallFrames) {
+            m_smallFrames = 0;
+            if (m_quality < m_requestedQuality) {
+                m_quality = std::min(m_requestedQuality, m_quality + QUALITY_STEP);
+            }
+            else {
+                setScale(m_scale / 2);
+            }
+        }
+    }
+
+    void setScale(uint32_t scale) noexcept {
+        m_scale = scale;
+        m_scaledLayout = (1 < scale) ? i420Layout((m_layout.width + scale - 1) / scale, (m_layout.height + scale - 1) / scale) : m_layout;
+    }
+
+    bool encode(const uint8_t *frame, const uint8_t *&jpeg, uint32_t &jpegSize) noexcept {
+        const I420Layout &layout{m_scaledLayout};
+#ifdef HAVE_TURBOJPEG
+        const unsigned char *planes[3]{frame + layout.offsetY, frame + layout.offsetU, frame + layout.offsetV};
+        const int strides[3]{static_cast<int>(layout.strideY), static_cast<int>(layout.strideU), static_cast<int>(layout.strideV)};
+        unsigned char *buffer{m_jpeg.data()};
+        unsigned long size{m_jpeg.size()};
+        if ( (nullptr == m_handle) ||
+             (0 != tjCompressFromYUVPlanes(m_handle, planes, static_cast<int>(layout.width), strides, static_cast<int>(layout.height), TJSAMP_420, &buffer, &size, m_quality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC)) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to compress frame: " << ((nullptr != m_handle) ? tjGetErrorStr2(m_handle) : "no TurboJPEG instance") << std::endl;
+            return false;
+        }
+        jpeg = buffer;
+        jpegSize = static_cast<uint32_t>(size);
+#else
+        // libyuv's RGB24 is B, G, R in memory as expected by OpenCV.
+        cv::Mat bgr(static_cast<int>(layout.height), static_cast<int>(layout.width), CV_8UC3, m_bgr.data);
+        libyuv::I420ToRGB24(frame + layout.offsetY, static_cast<int>(layout.strideY),
+                            frame + layout.offsetU, static_cast<int>(layout.strideU),
+                            frame + layout.offsetV, static_cast<int>(layout.strideV),
+                            bgr.data, static_cast<int>(bgr.step),
+                            static_cast<int>(layout.width), static_cast<int>(layout.height));
+        if (!cv::imencode(".jpg", bgr, m_jpeg, {cv::IMWRITE_JPEG_QUALITY, m_quality})) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to compress frame." << std::endl;
+            return false;
+        }
+        jpeg = m_jpeg.data();
+        jpegSize = static_cast<uint32_t>(m_jpeg.size());
+#endif
+        return true;
+    }
+
+   private:
+    const I420Layout m_layout;
+    I420Layout m_scaledLayout;
+    const int32_t m_requestedQuality;
+    const uint32_t m_maxSize;
+    int32_t m_quality;
+    uint32_t m_scale;
+    uint32_t m_smallFrames;
+    std::vector<uint8_t> m_scaled;
+#ifdef HAVE_TURBOJPEG
+    tjhandle m_handle;
+    std::vector<unsigned char> m_jpeg;
+#else
+    cv::Mat m_bgr;
+    std::vector<unsigned char> m_jpeg;
+#endif
+};
+
+/**
+ * JpegEncoder compresses the frames published in an I420 shared memory area
+ * and sends them as opendlv.proxy.ImageReading (format "jpeg") via OD4 for
+ * consumers that cannot attach to shared memory. Encoding runs on its own
+ * thread at a limited rate: the converting thread only signals new frames,
+ * and the encoder copies the frame while holding the shared memory's lock
+ * like any other consumer. Frames that became due while the encoder was still
+ * busy are dropped and counted. Frames are compressed with JpegCompressor so
+ * that each fits into one UDP packet.
+ */
+class JpegEncoder {
+   private:
+    JpegEncoder(const JpegEncoder &) = delete;
+    JpegEncoder(JpegEncoder &&)      = delete;
+    JpegEncoder &operator=(const JpegEncoder &) = delete;
+    JpegEncoder &operator=(JpegEncoder &&) = delete;
+
+   public:
+    // An envelope must fit into one UDP packet; leave room for the envelope's own fields.
+    static constexpr uint32_t MAX_MESSAGE_SIZE{65507 - 256};
+
+    /**
+     * Constructor.
+     *
+     * @param od4 OD4Session to send the compressed frames to.
+     * @param senderStamp senderStamp of the sent messages.
+     * @param sharedMemoryI420 Shared memory area with the I420 frames.
+     * @param layout Layout of the I420 frames.
+     * @param frequency Maximum number of frames to encode per second.
+     * @param quality JPEG quality between 1 and 100.
+     */
+    JpegEncoder(cluon::OD4Session &od4, uint32_t senderStamp, cluon::SharedMemory &sharedMemoryI420, const I420Layout &layout, float frequency, int32_t quality) noexcept
+        : m_od4(od4)
+        , m_senderStamp(senderStamp)
+        , m_sharedMemoryI420(sharedMemoryI420)
+        , m_layout(layout)
+        , m_period(static_cast<int64_t>(1000.0f * 1000.0f / frequency))
+        , m_quality(quality)
+        , m_compressor(layout, quality, MAX_MESSAGE_SIZE)
+        , m_frame(layout.size)
+        , m_mutex()
+        , m_condition()
+        , m_nextDue(0)
+        , m_isPending(false)
+        , m_running(true)
+        , m_encoded(0)
+        , m_dropped(0)
+        , m_oversized(0)
+        , m_thread() {
+        m_thread = std::thread(&JpegEncoder::run, this);
+    }
+
+    ~JpegEncoder() noexcept {
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_running = false;
+        }
+        m_condition.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    /**
+     * @return Name of the JPEG implementation in use.
+     */
+    static const char *backend() noexcept {
+        return JpegCompressor::backend();
+    }
+
+    /**
+     * This method signals that a new frame was published; it never blocks
+     * on the encoder.
+     *
+     * @param sampleTimeStamp Sample time stamp of the frame in microseconds.
+     */
+    void notify(int64_t sampleTimeStamp) noexcept {
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            if (sampleTimeStamp < m_nextDue) {
+                return;
+            }
+            // Keep the rate stable on jittering time stamps but do not catch up after gaps.
+            m_nextDue = (sampleTimeStamp - m_nextDue < m_period) ? m_nextDue + m_period : sampleTimeStamp + m_period;
+            m_dropped += (m_isPending ? 1 : 0);
+            m_isPending = true;
+        }
+        m_condition.notify_one();
+    }
+
+    uint64_t encoded() noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        return m_encoded;
+    }
+
+    uint64_t dropped() noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        return m_dropped;
+    }
+
+    uint64_t oversized() noexcept {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        return m_oversized;
+    }
+
+   private:
+    void run() noexcept {
+        FrameMetadata metadata;
+        bool hasReportedOversizedFrame{false};
+        bool hasReportedReduction{false};
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(m_mutex);
+                m_condition.wait(lck, [this]{ return !m_running || m_isPending; });
+                if (!m_running) {
+                    break;
+                }
+                m_isPending = false;
+            }
+
+            m_sharedMemoryI420.lock();
+            {
+                readFrameMetadata(m_sharedMemoryI420.data(), m_sharedMemoryI420.size(), metadata);
+                std::memcpy(m_frame.data(), m_sharedMemoryI420.data(), m_layout.size);
+            }
+            m_sharedMemoryI420.unlock();
+
+            const uint8_t *jpeg{nullptr};
+            uint32_t jpegSize{0};
+            if (!m_compressor.compress(m_frame.data(), jpeg, jpegSize)) {
+                continue;
+            }
+            if (!hasReportedReduction && ( (m_compressor.width() != m_layout.width) || (m_compressor.quality() != m_quality) )) {
+                std::clog << "[opendlv-device-camera-opencv]: Compressing JPEG frames at " << m_compressor.width() << "x" << m_compressor.height() << " with quality " << m_compressor.quality() << " to fit them into a UDP packet." << std::endl;
+                hasReportedReduction = true;
+            }
+            if (jpegSize > MAX_MESSAGE_SIZE) {
+                if (!hasReportedOversizedFrame) {
+                    std::cerr << "[opendlv-device-camera-opencv]: Compressed frame of " << jpegSize << " bytes does not fit into a UDP packet even at " << m_compressor.width() << "x" << m_compressor.height() << "." << std::endl;
+                    hasReportedOversizedFrame = true;
+                }
+                std::lock_guard<std::mutex> lck(m_mutex);
+                m_oversized++;
+                continue;
+            }
+
+            opendlv::proxy::ImageReading imageReading;
+            imageReading.format("jpeg").width(m_compressor.width()).height(m_compressor.height()).data(std::string(reinterpret_cast<const char*>(jpeg), jpegSize));
+            m_od4.send(imageReading, cluon::time::fromMicroseconds(metadata.sampleTimeStamp), m_senderStamp);
+
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_encoded++;
+        }
+    }
+
+   private:
+    cluon::OD4Session &m_od4;
+    const uint32_t m_senderStamp;
+    cluon::SharedMemory &m_sharedMemoryI420;
+    const I420Layout m_layout;
+    const int64_t m_period;
+    const int32_t m_quality;
+    JpegCompressor m_compressor;
+    std::vector<uint8_t> m_frame;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    int64_t m_nextDue;
+    bool m_isPending;
+    bool m_running;
+    uint64_t m_encoded;
+    uint64_t m_dropped;
+    uint64_t m_oversized;
+    std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LUMA_HISTOGRAM_HPP
+#define LUMA_HISTOGRAM_HPP
+
+#include "cpu-features.hpp"
+
+#if defined(HAVE_X86_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+// The histogram is computed from every fourth pixel of every fourth row, i.e.,
+// from 1/16 of the Y plane; this is plenty for exposure control.
+constexpr uint32_t LUMA_HISTOGRAM_STEP{4};
+// Luma values at or below/above these limits count as clipped.
+constexpr uint8_t LUMA_CLIPPED_DARK{4};
+constexpr uint8_t LUMA_CLIPPED_BRIGHT{251};
+
+/**
+ * Statistics derived from a luma histogram.
+ */
+struct LumaStatistics {
+    uint32_t samples{0};
+    uint32_t histogram[256]{};
+    float mean{0.0f};
+    float clippedDark{0.0f};   // Fraction of samples at or below LUMA_CLIPPED_DARK.
+    float clippedBright{0.0f}; // Fraction of samples at or above LUMA_CLIPPED_BRIGHT.
+};
+
+namespace detail {
+/**
+ * This function adds 16 samples to four interleaved sub-histograms so that
+ * consecutive samples falling into the same bin do not stall on each other.
+ */
+inline void addSamples(const uint8_t *samples, uint32_t (&subHistograms)[4][256]) noexcept {
+    for (uint32_t i{0}; i < 16; i += 4) {
+        subHistograms[0][samples[i + 0]]++;
+        subHistograms[1][samples[i + 1]]++;
+        subHistograms[2][samples[i + 2]]++;
+        subHistograms[3][samples[i + 3]]++;
+    }
+}
+
+/**
+ * This function adds the samples of a row from x on in scalar code.
+ *
+ * @return Number of samples.
+ */
+inline uint32_t addRemainingSamples(const uint8_t *line, uint32_t x, uint32_t width, uint32_t (&subHistograms)[4][256]) noexcept {
+    uint32_t samples{0};
+    for (; x < width; x += LUMA_HISTOGRAM_STEP) {
+        subHistograms[0][line[x]]++;
+        samples++;
+    }
+    return samples;
+}
+
+inline void mergeSubHistograms(const uint32_t (&subHistograms)[4][256], uint32_t (&histogram)[256]) noexcept {
+    for (uint32_t i{0}; i < 256; i++) {
+        histogram[i] = subHistograms[0][i] + subHistograms[1][i] + subHistograms[2][i] + subHistograms[3][i];
+    }
+}
+
+/**
+ * This function gathers every fourth pixel of a row in blocks of 64 pixels
+ * with SSE2 (masking and packing) or NEON (de-interleaving load) from x on.
+ *
+ * @return Number of samples.
+ */
+inline uint32_t addBaselineSamples(const uint8_t *line, uint32_t &x, uint32_t width, uint32_t (&subHistograms)[4][256]) noexcept {
+    uint32_t samples{0};
+#if defined(__SSE2__)
+    const __m128i MASK{_mm_set1_epi32(0xFF)};
+    alignas(16) uint8_t gathered[16];
+    for (; x + 64 <= width; x += 64) {
+        const __m128i A{_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x)), MASK)};
+        const __m128i B{_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x + 16)), MASK)};
+        const __m128i C{_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x + 32)), MASK)};
+        const __m128i D{_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x + 48)), MASK)};
+        _mm_store_si128(reinterpret_cast<__m128i*>(gathered), _mm_packus_epi16(_mm_packs_epi32(A, B), _mm_packs_epi32(C, D)));
+        addSamples(gathered, subHistograms);
+        samples += 16;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8_t gathered[16];
+    for (; x + 64 <= width; x += 64) {
+        vst1q_u8(gathered, vld4q_u8(line + x).val[0]);
+        addSamples(gathered, subHistograms);
+        samples += 16;
+    }
+#else
+    (void)line;
+    (void)width;
+    (void)subHistograms;
+#endif
+    return samples;
+}
+} // namespace detail
+
+/**
+ * This function computes the subsampled histogram of a Y plane with the
+ * baseline instruction set of the binary; 64 pixels of a row are gathered to
+ * 16 samples at once and the remainder is handled in scalar code.
+ *
+ * @return Number of samples.
+ */
+inline uint32_t lumaHistogramBaseline(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height, uint32_t (&histogram)[256]) noexcept {
+    uint32_t subHistograms[4][256];
+    std::memset(subHistograms, 0, sizeof(subHistograms));
+
+    uint32_t samples{0};
+    for (uint32_t row{0}; row < height; row += LUMA_HISTOGRAM_STEP) {
+        const uint8_t *line{y + static_cast<std::size_t>(row) * stride};
+        uint32_t x{0};
+        samples += detail::addBaselineSamples(line, x, width, subHistograms);
+        samples += detail::addRemainingSamples(line, x, width, subHistograms);
+    }
+    detail::mergeSubHistograms(subHistograms, histogram);
+    return samples;
+}
+
+#ifdef HAVE_X86_DISPATCH
+/**
+ * This function is lumaHistogramBaseline gathering 128 pixels to 32 samples
+ * at once with AVX2; the packing works within 128 bit lanes, which permutes
+ * the samples but does not change the histogram.
+ *
+ * @return Number of samples.
+ */
+TARGET_AVX2 inline uint32_t lumaHistogramAVX2(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height, uint32_t (&histogram)[256]) noexcept {
+    uint32_t subHistograms[4][256];
+    std::memset(subHistograms, 0, sizeof(subHistograms));
+
+    const __m256i MASK{_mm256_set1_epi32(0xFF)};
+    alignas(32) uint8_t gathered[32];
+    uint32_t samples{0};
+    for (uint32_t row{0}; row < height; row += LUMA_HISTOGRAM_STEP) {
+        const uint8_t *line{y + static_cast<std::size_t>(row) * stride};
+        uint32_t x{0};
+        for (; x + 128 <= width; x += 128) {
+            const __m256i A{_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x)), MASK)};
+            const __m256i B{_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x + 32)), MASK)};
+            const __m256i C{_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x + 64)), MASK)};
+            const __m256i D{_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x + 96)), MASK)};
+            _mm256_store_si256(reinterpret_cast<__m256i*>(gathered), _mm256_packus_epi16(_mm256_packs_epi32(A, B), _mm256_packs_epi32(C, D)));
+            detail::addSamples(gathered, subHistograms);
+            detail::addSamples(gathered + 16, subHistograms);
+            samples += 32;
+        }
+        samples += detail::addBaselineSamples(line, x, width, subHistograms);
+        samples += detail::addRemainingSamples(line, x, width, subHistograms);
+    }
+    detail::mergeSubHistograms(subHistograms, histogram);
+    return samples;
+}
+
+/**
+ * This function is lumaHistogramBaseline gathering 256 pixels to 64 samples
+ * at once with AVX-512 by truncating 32 bit lanes to their lowest byte.
+ *
+ * @return Number of samples.
+ */
+TARGET_AVX512 inline uint32_t lumaHistogramAVX512(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height, uint32_t (&histogram)[256]) noexcept {
+    uint32_t subHistograms[4][256];
+    std::memset(subHistograms, 0, sizeof(subHistograms));
+
+    uint8_t gathered[64];
+    uint32_t samples{0};
+    for (uint32_t row{0}; row < height; row += LUMA_HISTOGRAM_STEP) {
+        const uint8_t *line{y + static_cast<std::size_t>(row) * stride};
+        uint32_t x{0};
+        for (; x + 256 <= width; x += 256) {
+            for (uint32_t i{0}; i < 4; i++) {
+                _mm512_mask_cvtepi32_storeu_epi8(gathered + i * 16, 0xFFFF, _mm512_loadu_si512(line + x + i * 64));
+            }
+            for (uint32_t i{0}; i < 4; i++) {
+                detail::addSamples(gathered + i * 16, subHistograms);
+            }
+            samples += 64;
+        }
+        samples += detail::addBaselineSamples(line, x, width, subHistograms);
+        samples += detail::addRemainingSamples(line, x, width, subHistograms);
+    }
+    detail::mergeSubHistograms(subHistograms, histogram);
+    return samples;
+}
+#endif
+
+/**
+ * @return Name of the variant used by lumaHistogram on this CPU.
+ */
+inline const char *lumaHistogramVariant() noexcept {
+#ifdef HAVE_X86_DISPATCH
+    if (cpuFeatures().avx512) {
+        return "avx512";
+    }
+    if (cpuFeatures().avx2) {
+        return "avx2";
+    }
+#endif
+    return baselineInstructionSet();
+}
+
+/**
+ * This function computes the subsampled histogram of a Y plane with the
+ * widest variant supported by this CPU. The baseline variant is called
+ * directly so that it can still be inlined with constant geometries.
+ *
+ * @return Number of samples.
+ */
+inline uint32_t lumaHistogram(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height, uint32_t (&histogram)[256]) noexcept {
+#ifdef HAVE_X86_DISPATCH
+    if (cpuFeatures().avx512) {
+        return lumaHistogramAVX512(y, stride, width, height, histogram);
+    }
+    if (cpuFeatures().avx2) {
+        return lumaHistogramAVX2(y, stride, width, height, histogram);
+    }
+#endif
+    return lumaHistogramBaseline(y, stride, width, height, histogram);
+}
+
+/**
+ * This function is the plain scalar reference for lumaHistogram.
+ *
+ * @return Number of samples.
+ */
+inline uint32_t lumaHistogramScalar(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height, uint32_t (&histogram)[256]) noexcept {
+    std::memset(histogram, 0, sizeof(histogram));
+    uint32_t samples{0};
+    for (uint32_t row{0}; row < height; row += LUMA_HISTOGRAM_STEP) {
+        const uint8_t *line{y + static_cast<std::size_t>(row) * stride};
+        for (uint32_t x{0}; x < width; x += LUMA_HISTOGRAM_STEP) {
+            histogram[line[x]]++;
+            samples++;
+        }
+    }
+    return samples;
+}
+
+/**
+ * @return Statistics of the given Y plane.
+ */
+inline LumaStatistics lumaStatistics(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height) noexcept {
+    LumaStatistics statistics;
+    statistics.samples = lumaHistogram(y, stride, width, height, statistics.histogram);
+    if (0 < statistics.samples) {
+        uint64_t sum{0};
+        uint32_t dark{0};
+        uint32_t bright{0};
+        for (uint32_t i{0}; i < 256; i++) {
+            sum += static_cast<uint64_t>(i) * statistics.histogram[i];
+            dark += (i <= LUMA_CLIPPED_DARK) ? statistics.histogram[i] : 0;
+            bright += (i >= LUMA_CLIPPED_BRIGHT) ? statistics.histogram[i] : 0;
+        }
+        statistics.mean = static_cast<float>(sum) / static_cast<float>(statistics.samples);
+        statistics.clippedDark = static_cast<float>(dark) / static_cast<float>(statistics.samples);
+        statistics.clippedBright = static_cast<float>(bright) / static_cast<float>(statistics.samples);
+    }
+    return statistics;
+}
+
+#endif
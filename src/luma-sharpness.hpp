@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LUMA_SHARPNESS_HPP
+#define LUMA_SHARPNESS_HPP
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <cstdint>
+
+// Sharpness is measured as the variance of the 4-neighbour Laplacian, which is
+// high for frames with crisp edges and low for blurred or defocused ones. The
+// Laplacian is evaluated for all pixels of every fourth row, i.e., for 1/4 of
+// the Y plane without the border pixels.
+constexpr uint32_t LUMA_SHARPNESS_ROW_STEP{4};
+
+/**
+ * Sums of the Laplacian over the sampled pixels of a Y plane.
+ */
+struct LaplacianSums {
+    uint64_t samples{0};
+    int64_t sum{0};
+    uint64_t sumOfSquares{0};
+};
+
+namespace detail {
+inline int32_t laplacian(const uint8_t *above, const uint8_t *row, const uint8_t *below, uint32_t x) noexcept {
+    return 4 * row[x] - row[x - 1] - row[x + 1] - above[x] - below[x];
+}
+} // namespace detail
+
+/**
+ * This function is the plain scalar reference for laplacianSums.
+ */
+inline LaplacianSums laplacianSumsScalar(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height) noexcept {
+    LaplacianSums sums;
+    for (uint32_t r{1}; r + 1 < height; r += LUMA_SHARPNESS_ROW_STEP) {
+        const uint8_t *row{y + static_cast<std::size_t>(r) * stride};
+        for (uint32_t x{1}; x + 1 < width; x++) {
+            const int32_t L{detail::laplacian(row - stride, row, row + stride, x)};
+            sums.sum += L;
+            sums.sumOfSquares += static_cast<uint64_t>(L * L);
+            sums.samples++;
+        }
+    }
+    return sums;
+}
+
+/**
+ * This function computes the sums of the Laplacian of a Y plane for 8 pixels
+ * at once in 16 bit lanes with SSE2 or NEON; the remainder of each row is
+ * handled in scalar code. The per-row sums of squares fit into 32 bit lanes
+ * for rows of up to 16000 pixels.
+ */
+inline LaplacianSums laplacianSums(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height) noexcept {
+    LaplacianSums sums;
+    for (uint32_t r{1}; r + 1 < height; r += LUMA_SHARPNESS_ROW_STEP) {
+        const uint8_t *row{y + static_cast<std::size_t>(r) * stride};
+        const uint8_t *above{row - stride};
+        const uint8_t *below{row + stride};
+        uint32_t x{1};
+#if defined(__SSE2__)
+        const __m128i ZERO{_mm_setzero_si128()};
+        const __m128i ONES{_mm_set1_epi16(1)};
+        __m128i rowSum{_mm_setzero_si128()};
+        __m128i rowSumOfSquares{_mm_setzero_si128()};
+        auto load = [&ZERO](const uint8_t *p) {
+            return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), ZERO);
+        };
+        for (; x + 9 <= width; x += 8) {
+            const __m128i NEIGHBOURS{_mm_add_epi16(_mm_add_epi16(load(row + x - 1), load(row + x + 1)), _mm_add_epi16(load(above + x), load(below + x)))};
+            const __m128i L{_mm_sub_epi16(_mm_slli_epi16(load(row + x), 2), NEIGHBOURS)};
+            rowSum = _mm_add_epi32(rowSum, _mm_madd_epi16(L, ONES));
+            rowSumOfSquares = _mm_add_epi32(rowSumOfSquares, _mm_madd_epi16(L, L));
+        }
+        alignas(16) int32_t lanes[4];
+        alignas(16) uint32_t squares[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), rowSum);
+        _mm_store_si128(reinterpret_cast<__m128i*>(squares), rowSumOfSquares);
+        sums.sum += static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        sums.sumOfSquares += static_cast<uint64_t>(squares[0]) + squares[1] + squares[2] + squares[3];
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        int32x4_t rowSum{vdupq_n_s32(0)};
+        uint32x4_t rowSumOfSquares{vdupq_n_u32(0)};
+        auto load = [](const uint8_t *p) {
+            return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+        };
+        for (; x + 9 <= width; x += 8) {
+            const int16x8_t NEIGHBOURS{vaddq_s16(vaddq_s16(load(row + x - 1), load(row + x + 1)), vaddq_s16(load(above + x), load(below + x)))};
+            const int16x8_t L{vsubq_s16(vshlq_n_s16(load(row + x), 2), NEIGHBOURS)};
+            rowSum = vpadalq_s16(rowSum, L);
+            rowSumOfSquares = vaddq_u32(rowSumOfSquares, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(L), vget_low_s16(L))));
+            rowSumOfSquares = vaddq_u32(rowSumOfSquares, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(L), vget_high_s16(L))));
+        }
+        sums.sum += static_cast<int64_t>(vgetq_lane_s32(rowSum, 0)) + vgetq_lane_s32(rowSum, 1) + vgetq_lane_s32(rowSum, 2) + vgetq_lane_s32(rowSum, 3);
+        sums.sumOfSquares += static_cast<uint64_t>(vgetq_lane_u32(rowSumOfSquares, 0)) + vgetq_lane_u32(rowSumOfSquares, 1) + vgetq_lane_u32(rowSumOfSquares, 2) + vgetq_lane_u32(rowSumOfSquares, 3);
+#endif
+        sums.samples += x - 1;
+        for (; x + 1 < width; x++) {
+            const int32_t L{detail::laplacian(above, row, below, x)};
+            sums.sum += L;
+            sums.sumOfSquares += static_cast<uint64_t>(L * L);
+            sums.samples++;
+        }
+    }
+    return sums;
+}
+
+/**
+ * @return Variance of the Laplacian described by sums; 0 without samples.
+ */
+inline float laplacianVariance(const LaplacianSums &sums) noexcept {
+    if (0 == sums.samples) {
+        return 0.0f;
+    }
+    const double MEAN{static_cast<double>(sums.sum) / static_cast<double>(sums.samples)};
+    return static_cast<float>(static_cast<double>(sums.sumOfSquares) / static_cast<double>(sums.samples) - MEAN * MEAN);
+}
+
+/**
+ * @return Variance of the Laplacian of the given Y plane; 0 for planes smaller than 3x3.
+ */
+inline float lumaSharpness(const uint8_t *y, uint32_t stride, uint32_t width, uint32_t height) noexcept {
+    return laplacianVariance(laplacianSums(y, stride, width, height));
+}
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOTION_GATE_HPP
+#define MOTION_GATE_HPP
+
+#include "frame-layout.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * This function sums the absolute differences of two byte arrays whose size
+ * is a multiple of 16 with SSE2 (psadbw) or NEON (vabd and pairwise adds).
+ *
+ * @return Sum of absolute differences.
+ */
+inline uint32_t sumOfAbsoluteDifferences(const uint8_t *a, const uint8_t *b, uint32_t size) noexcept {
+    uint32_t sum{0};
+#if defined(__SSE2__)
+    __m128i sums{_mm_setzero_si128()};
+    for (uint32_t i{0}; i < size; i += 16) {
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+    }
+    sum = static_cast<uint32_t>(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t sums{vdupq_n_u32(0)};
+    for (uint32_t i{0}; i < size; i += 16) {
+        sums = vpadalq_u16(sums, vpaddlq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i))));
+    }
+    sum = vgetq_lane_u32(sums, 0) + vgetq_lane_u32(sums, 1) + vgetq_lane_u32(sums, 2) + vgetq_lane_u32(sums, 3);
+#else
+    for (uint32_t i{0}; i < size; i++) {
+        sum += static_cast<uint32_t>(std::abs(static_cast<int32_t>(a[i]) - static_cast<int32_t>(b[i])));
+    }
+#endif
+    return sum;
+}
+
+/**
+ * MotionGate decides for each captured frame whether it differs from the last
+ * published one so that unchanged frames are neither converted nor published.
+ *
+ * Each frame is reduced to a signature of at most 64x36 luma values, each the
+ * mean of four neighbouring pixels of a grid cell, taken directly from the
+ * captured YUYV422 or RGB24 frame. A frame has changed if the mean absolute
+ * difference along any signature row exceeds the threshold; comparing rows
+ * instead of whole signatures keeps small moving objects from being averaged
+ * away. The signature of a published frame becomes the new reference so that
+ * slow changes add up until they are published. Unchanged frames are still
+ * published at the keep-alive interval so that consumers see the camera alive.
+ */
+class MotionGate {
+   private:
+    MotionGate(const MotionGate &) = delete;
+    MotionGate(MotionGate &&)      = delete;
+    MotionGate &operator=(const MotionGate &) = delete;
+    MotionGate &operator=(MotionGate &&) = delete;
+
+    static constexpr uint32_t SIGNATURE_COLUMNS{64};
+    static constexpr uint32_t SIGNATURE_ROWS{36};
+    static constexpr uint32_t PIXELS_PER_SAMPLE{4};
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param width Width of the captured frames.
+     * @param height Height of the captured frames.
+     * @param isYUYV422 true for YUYV422 frames, false for RGB24 frames.
+     * @param threshold Mean absolute luma difference along a signature row to consider a frame changed.
+     * @param keepAliveInterval Maximum time between two published frames in microseconds.
+     */
+    MotionGate(uint32_t width, uint32_t height, bool isYUYV422, float threshold, int64_t keepAliveInterval) noexcept
+        : m_isYUYV422(isYUYV422)
+        , m_columns(std::max(1u, std::min(uint32_t{SIGNATURE_COLUMNS}, width / PIXELS_PER_SAMPLE)))
+        , m_rows(std::max(1u, std::min(uint32_t{SIGNATURE_ROWS}, height)))
+        , m_maximumRowDifference(static_cast<uint32_t>(threshold * static_cast<float>(m_columns)))
+        , m_keepAliveInterval(keepAliveInterval)
+        , m_columnOffsets(m_columns)
+        , m_rowOffsets(m_rows)
+        , m_signature(m_rows * SIGNATURE_COLUMNS, 0)
+        , m_reference(m_rows * SIGNATURE_COLUMNS, 0)
+        , m_hasReference(false)
+        , m_isKeepAlive(false)
+        , m_lastPublished(0)
+        , m_skipped(0) {
+        // The samples of a cell are centered in the cell; narrow frames repeat pixels.
+        const uint32_t BYTES_PER_PIXEL{isYUYV422 ? 2u : 3u};
+        const uint32_t STRIDE{isYUYV422 ? yuyv422Stride(width) : rgb24Stride(width)};
+        for (uint32_t c{0}; c < m_columns; c++) {
+            const uint32_t CENTER{(2 * c + 1) * width / (2 * m_columns)};
+            const uint32_t X{std::min((CENTER >= PIXELS_PER_SAMPLE / 2) ? CENTER - PIXELS_PER_SAMPLE / 2 : 0, (width >= PIXELS_PER_SAMPLE) ? width - PIXELS_PER_SAMPLE : 0)};
+            m_columnOffsets[c] = X * BYTES_PER_PIXEL;
+        }
+        for (uint32_t r{0}; r < m_rows; r++) {
+            m_rowOffsets[r] = static_cast<std::size_t>((2 * r + 1) * height / (2 * m_rows)) * STRIDE;
+        }
+    }
+
+    /**
+     * This method computes the signature of a captured frame and decides
+     * whether to publish it; the frame is published if it changed, if the
+     * keep-alive interval elapsed, or if force is set.
+     *
+     * @param frame Captured frame.
+     * @param sampleTimeStamp Sample time stamp of the frame in microseconds.
+     * @param force Publish the frame in any case, e.g., after a discontinuity.
+     * @return true if the frame shall be published.
+     */
+    bool update(const uint8_t *frame, int64_t sampleTimeStamp, bool force) noexcept {
+        computeSignature(frame);
+        bool hasChanged{force || !m_hasReference};
+        for (uint32_t r{0}; (r < m_rows) && !hasChanged; r++) {
+            hasChanged = (sumOfAbsoluteDifferences(&m_signature[r * SIGNATURE_COLUMNS], &m_reference[r * SIGNATURE_COLUMNS], SIGNATURE_COLUMNS) > m_maximumRowDifference);
+        }
+        m_isKeepAlive = !hasChanged && (sampleTimeStamp - m_lastPublished >= m_keepAliveInterval);
+        if (!hasChanged && !m_isKeepAlive) {
+            m_skipped++;
+            return false;
+        }
+        m_signature.swap(m_reference);
+        m_hasReference = true;
+        m_lastPublished = sampleTimeStamp;
+        return true;
+    }
+
+    /**
+     * @return true if the last published frame was published only to keep the consumers alive.
+     */
+    bool isKeepAlive() const noexcept {
+        return m_isKeepAlive;
+    }
+
+    /**
+     * @return Number of frames that were skipped as unchanged.
+     */
+    uint64_t skipped() const noexcept {
+        return m_skipped;
+    }
+
+   private:
+    void computeSignature(const uint8_t *frame) noexcept {
+        for (uint32_t r{0}; r < m_rows; r++) {
+            const uint8_t *row{frame + m_rowOffsets[r]};
+            uint8_t *signature{&m_signature[r * SIGNATURE_COLUMNS]};
+            for (uint32_t c{0}; c < m_columns; c++) {
+                const uint8_t *pixel{row + m_columnOffsets[c]};
+                uint32_t sum{0};
+                if (m_isYUYV422) {
+                    // Luma is every other byte.
+                    sum = pixel[0] + pixel[2] + pixel[4] + pixel[6];
+                }
+                else {
+                    // Approximate luma (B + 2G + R) / 4 of OpenCV's BGR order.
+                    for (uint32_t i{0}; i < PIXELS_PER_SAMPLE * 3; i += 3) {
+                        sum += (pixel[i] + 2 * pixel[i + 1] + pixel[i + 2] + 2) / 4;
+                    }
+                }
+                signature[c] = static_cast<uint8_t>(sum / PIXELS_PER_SAMPLE);
+            }
+        }
+    }
+
+   private:
+    const bool m_isYUYV422;
+    const uint32_t m_columns;
+    const uint32_t m_rows;
+    const uint32_t m_maximumRowDifference;
+    const int64_t m_keepAliveInterval;
+    std::vector<uint32_t> m_columnOffsets;
+    std::vector<std::size_t> m_rowOffsets;
+    std::vector<uint8_t> m_signature;
+    std::vector<uint8_t> m_reference;
+    bool m_hasReference;
+    bool m_isKeepAlive;
+    int64_t m_lastPublished;
+    uint64_t m_skipped;
+};
+
+#endif
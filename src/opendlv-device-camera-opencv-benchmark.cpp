@@ -0,0 +1,1028 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "capture-supervisor.hpp"
+#include "colour-correction.hpp"
+#include "cpu-features.hpp"
+#include "frame-archive.hpp"
+#include "frame-composite.hpp"
+#include "frame-conversion.hpp"
+#include "frame-layout.hpp"
+#include "frame-metadata.hpp"
+#include "frame-orientation.hpp"
+#include "frame-pipeline.hpp"
+#include "frame-player.hpp"
+#include "frame-pool.hpp"
+#include "frame-recorder.hpp"
+#include "frame-source.hpp"
+#include "frame-synchronizer.hpp"
+#include "huge-pages.hpp"
+#include "jpeg-encoder.hpp"
+#include "luma-histogram.hpp"
+#include "luma-sharpness.hpp"
+#include "motion-gate.hpp"
+#include "realtime-scheduling.hpp"
+#include "temporal-denoiser.hpp"
+
+#include <libyuv.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+// Number of heap allocations done by this process so far.
+std::atomic<uint64_t> numberOfAllocations{0};
+} // namespace
+
+// Count all heap allocations including the ones done inside OpenCV to verify
+// that capturing and publishing a frame does not allocate in steady state.
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(std::size_t);
+void *__libc_calloc(std::size_t, std::size_t);
+void *__libc_realloc(void *, std::size_t);
+void *__libc_memalign(std::size_t, std::size_t);
+
+void *malloc(std::size_t size) noexcept {
+    numberOfAllocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size) noexcept {
+    numberOfAllocations++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, std::size_t size) noexcept {
+    numberOfAllocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(std::size_t alignment, std::size_t size) noexcept {
+    numberOfAllocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) noexcept {
+    numberOfAllocations++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, std::size_t alignment, std::size_t size) noexcept {
+    numberOfAllocations++;
+    *ptr = __libc_memalign(alignment, size);
+    return (nullptr == *ptr) ? ENOMEM : 0;
+}
+}
+#else
+// Without glibc, only allocations via operator new can be counted.
+void *operator new(std::size_t size) {
+    numberOfAllocations++;
+    void *ptr = std::malloc(size);
+    if (nullptr == ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+#endif
+
+namespace {
+
+struct Resolution {
+    uint32_t width;
+    uint32_t height;
+};
+
+struct Result {
+    std::string name;
+    Resolution resolution;
+    uint32_t iterations;
+    double min;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    double allocationsPerFrame;
+};
+
+// Summarize the given latencies in microseconds.
+Result summarize(const std::string &name, const Resolution &resolution, std::vector<double> durations, double allocationsPerFrame) {
+    std::sort(durations.begin(), durations.end());
+
+    auto percentile = [&durations](double p) {
+        const std::size_t index{static_cast<std::size_t>(p * static_cast<double>(durations.size() - 1) + 0.5)};
+        return durations[index];
+    };
+    double sum{0};
+    for (auto d : durations) {
+        sum += d;
+    }
+
+    return Result{name, resolution, static_cast<uint32_t>(durations.size()), durations.front(), sum / static_cast<double>(durations.size()),
+                  percentile(0.5), percentile(0.9), percentile(0.99), durations.back(),
+                  allocationsPerFrame};
+}
+
+// Run the given function iterations times after a short warm-up and collect
+// the latency of each single call in microseconds.
+Result measure(const std::string &name, const Resolution &resolution, uint32_t iterations, const std::function<void()> &f) {
+    constexpr uint32_t WARMUP{10};
+    for (uint32_t i{0}; i < WARMUP; i++) {
+        f();
+    }
+
+    std::vector<double> durations;
+    durations.reserve(iterations);
+    const uint64_t ALLOCATIONS_BEFORE{numberOfAllocations.load()};
+    for (uint32_t i{0}; i < iterations; i++) {
+        auto before = std::chrono::steady_clock::now();
+        f();
+        auto after = std::chrono::steady_clock::now();
+        durations.push_back(std::chrono::duration<double, std::micro>(after - before).count());
+    }
+    const uint64_t ALLOCATIONS{numberOfAllocations.load() - ALLOCATIONS_BEFORE};
+    return summarize(name, resolution, durations, static_cast<double>(ALLOCATIONS) / static_cast<double>(iterations));
+}
+
+// Run the given functions alternately, one call each per iteration, so that
+// all of them see the same load of the machine when comparing them.
+std::vector<Result> measureAlternately(const std::vector<std::string> &names, const Resolution &resolution, uint32_t iterations, const std::vector<std::function<void()>> &functions) {
+    constexpr uint32_t WARMUP{10};
+    for (uint32_t i{0}; i < WARMUP; i++) {
+        for (auto &f : functions) {
+            f();
+        }
+    }
+
+    std::vector<std::vector<double>> durations(functions.size());
+    std::vector<uint64_t> allocations(functions.size(), 0);
+    for (auto &d : durations) {
+        d.reserve(iterations);
+    }
+    for (uint32_t i{0}; i < iterations; i++) {
+        for (std::size_t j{0}; j < functions.size(); j++) {
+            const uint64_t ALLOCATIONS_BEFORE{numberOfAllocations.load()};
+            auto before = std::chrono::steady_clock::now();
+            functions[j]();
+            auto after = std::chrono::steady_clock::now();
+            allocations[j] += numberOfAllocations.load() - ALLOCATIONS_BEFORE;
+            durations[j].push_back(std::chrono::duration<double, std::micro>(after - before).count());
+        }
+    }
+    std::vector<Result> results;
+    for (std::size_t j{0}; j < functions.size(); j++) {
+        results.push_back(summarize(names[j], resolution, durations[j], static_cast<double>(allocations[j]) / static_cast<double>(iterations)));
+    }
+    return results;
+}
+
+std::string toJSON(const std::string &label, const std::vector<Result> &results) {
+    std::stringstream sstr;
+    sstr << "{" << std::endl
+         << "  \"benchmark\": \"opendlv-device-camera-opencv\"," << std::endl
+         << "  \"label\": \"" << label << "\"," << std::endl
+         << "  \"kernels\": \"" << lumaHistogramVariant() << "\"," << std::endl
+         << "  \"timestamp\": " << cluon::time::toMicroseconds(cluon::time::now()) << "," << std::endl
+         << "  \"results\": [" << std::endl;
+    for (std::size_t i{0}; i < results.size(); i++) {
+        const Result &r{results[i]};
+        const double PIXELS{static_cast<double>(r.resolution.width) * static_cast<double>(r.resolution.height)};
+        sstr << "    {\"name\": \"" << r.name << "\""
+             << ", \"width\": " << r.resolution.width
+             << ", \"height\": " << r.resolution.height
+             << ", \"iterations\": " << r.iterations
+             << ", \"latency_us\": {\"min\": " << r.min << ", \"mean\": " << r.mean << ", \"p50\": " << r.p50
+             << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99 << ", \"max\": " << r.max << "}"
+             << ", \"frames_per_second\": " << (1000.0 * 1000.0 / r.mean)
+             << ", \"megapixels_per_second\": " << (PIXELS / r.mean)
+             << ", \"allocations_per_frame\": " << r.allocationsPerFrame << "}"
+             << ((i + 1 < results.size()) ? "," : "") << std::endl;
+    }
+    sstr << "  ]" << std::endl << "}" << std::endl;
+    return sstr.str();
+}
+
+bool parseResolutions(const std::string &str, std::vector<Resolution> &resolutions) {
+    resolutions.clear();
+    // stringtoolbox::split returns nothing for a string without the delimiter.
+    const std::vector<std::string> ENTRIES{(std::string::npos == str.find(',')) ? std::vector<std::string>{str} : stringtoolbox::split(str, ',')};
+    for (auto entry : ENTRIES) {
+        auto dimensions = stringtoolbox::split(entry, 'x');
+        if (2 != dimensions.size()) {
+            return false;
+        }
+        const int32_t WIDTH{std::stoi(dimensions[0])};
+        const int32_t HEIGHT{std::stoi(dimensions[1])};
+        if ( (WIDTH <= 0) || (HEIGHT <= 0) ) {
+            return false;
+        }
+        resolutions.push_back(Resolution{static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT)});
+    }
+    return !resolutions.empty();
+}
+
+/**
+ * This function extracts the luma of frame as published with --gray and
+ * converts frame into I420.
+ *
+ * @return true if the luma equals the Y plane of the I420 frame.
+ */
+bool matchesI420Luma(const uint8_t *frame, bool isYUYV422, const I420Layout &layoutI420, const GrayLayout &layoutGray) {
+    std::vector<uint8_t> i420(layoutI420.size);
+    std::vector<uint8_t> gray(layoutGray.size);
+    convertToI420(frame, isYUYV422, i420.data(), layoutI420);
+    convertToGray(frame, isYUYV422, gray.data(), layoutGray);
+    bool retVal{true};
+    for (uint32_t y{0}; y < layoutGray.height; y++) {
+        retVal &= (0 == std::memcmp(gray.data() + y * layoutGray.stride, i420.data() + layoutI420.offsetY + y * layoutI420.strideY, layoutGray.width));
+    }
+    return retVal;
+}
+
+/**
+ * This function converts frame into both layouts twice, once into buffers
+ * filled with 0x00 and once into buffers filled with 0xFF: a byte that was
+ * written has the same value in both runs and a byte that was not keeps the
+ * fill value. This reveals chroma that is truncated at odd resolutions as
+ * well as writes into padding or beyond the end of a frame.
+ *
+ * @return true if exactly the pixels of all planes were written.
+ */
+bool writesExactlyLayout(const uint8_t *frame, bool isYUYV422, const I420Layout &layoutI420, const ARGBLayout &layoutARGB) {
+    constexpr uint32_t GUARD{4096};
+    std::vector<uint8_t> i420[2]{std::vector<uint8_t>(layoutI420.size + GUARD, 0x00), std::vector<uint8_t>(layoutI420.size + GUARD, 0xFF)};
+    std::vector<uint8_t> argb[2]{std::vector<uint8_t>(layoutARGB.size + GUARD, 0x00), std::vector<uint8_t>(layoutARGB.size + GUARD, 0xFF)};
+    for (uint32_t i{0}; i < 2; i++) {
+        convertToI420(frame, isYUYV422, i420[i].data(), layoutI420);
+        convertI420ToARGB(i420[i].data(), layoutI420, argb[i].data(), layoutARGB);
+    }
+
+    auto isPixel = [](uint32_t offset, uint32_t begin, uint32_t stride, uint32_t width, uint32_t height) {
+        return (begin <= offset) && (offset < begin + stride * height) && ((offset - begin) % stride < width);
+    };
+    bool retVal{true};
+    for (uint32_t offset{0}; offset < i420[0].size(); offset++) {
+        const bool WRITTEN{i420[0][offset] == i420[1][offset]};
+        const bool PIXEL{isPixel(offset, layoutI420.offsetY, layoutI420.strideY, layoutI420.width, layoutI420.height) ||
+                         isPixel(offset, layoutI420.offsetU, layoutI420.strideU, chromaWidth(layoutI420.width), chromaHeight(layoutI420.height)) ||
+                         isPixel(offset, layoutI420.offsetV, layoutI420.strideV, chromaWidth(layoutI420.width), chromaHeight(layoutI420.height))};
+        retVal &= (WRITTEN == PIXEL);
+    }
+    for (uint32_t offset{0}; offset < argb[0].size(); offset++) {
+        const bool WRITTEN{argb[0][offset] == argb[1][offset]};
+        retVal &= (WRITTEN == isPixel(offset, 0, layoutARGB.stride, layoutARGB.width * 4, layoutARGB.height));
+    }
+    return retVal;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char **argv) {
+    int32_t retCode{1};
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " measures latency and throughput of the colour conversions and of the shared memory publishing cycle used by opendlv-device-camera-opencv." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--out=<file>] [--iterations=<n>] [--resolutions=<WxH,...>] [--label=<text>]" << std::endl;
+        std::cerr << "         --out:         JSON file to write the results to; when omitted, opendlv-device-camera-opencv-benchmark.json is chosen" << std::endl;
+        std::cerr << "         --iterations:  number of measured iterations per case; when omitted, 200 is chosen" << std::endl;
+        std::cerr << "         --resolutions: comma-separated list of resolutions; when omitted, 640x480,1278x958,1280x720,1920x1080 is chosen" << std::endl;
+        std::cerr << "         --label:       free text stored with the results (e.g., the commit hash) to compare runs" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --iterations=500 --label=$(git rev-parse --short HEAD)" << std::endl;
+        return retCode;
+    }
+
+    const std::string OUT{(commandlineArguments["out"].size() != 0) ? commandlineArguments["out"] : "opendlv-device-camera-opencv-benchmark.json"};
+    const uint32_t ITERATIONS{(commandlineArguments["iterations"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["iterations"])) : 200};
+    const std::string LABEL{commandlineArguments["label"]};
+    std::vector<Resolution> resolutions;
+    if (!parseResolutions((commandlineArguments["resolutions"].size() != 0) ? commandlineArguments["resolutions"] : "640x480,1278x958,1280x720,1920x1080", resolutions)) {
+        std::cerr << "[opendlv-device-camera-opencv-benchmark]: Could not parse resolutions '" << commandlineArguments["resolutions"] << "'." << std::endl;
+        return retCode;
+    }
+    if (0 == ITERATIONS) {
+        std::cerr << "[opendlv-device-camera-opencv-benchmark]: iterations must be larger than 0." << std::endl;
+        return retCode;
+    }
+
+    std::vector<Result> results;
+    bool pipelineFaulty{false};
+    for (auto resolution : resolutions) {
+        const uint32_t WIDTH{resolution.width};
+        const uint32_t HEIGHT{resolution.height};
+
+        // Synthetic input frames with some structure to avoid trivial data.
+        std::vector<uint8_t> yuyv(yuyv422Stride(WIDTH) * HEIGHT);
+        std::vector<uint8_t> rgb24(WIDTH * HEIGHT * 3);
+        for (std::size_t i{0}; i < yuyv.size(); i++) {
+            yuyv[i] = static_cast<uint8_t>((i * 7 + (i / WIDTH) * 3) & 0xFF);
+        }
+        for (std::size_t i{0}; i < rgb24.size(); i++) {
+            rgb24[i] = static_cast<uint8_t>((i * 5 + (i / WIDTH) * 11) & 0xFF);
+        }
+        // Default packed layout and aligned layout with 64 byte strides and plane starts.
+        struct Layout {
+            std::string suffix;
+            I420Layout i420;
+            ARGBLayout argb;
+            GrayLayout gray;
+        };
+        const std::vector<Layout> LAYOUTS{
+            Layout{"", i420Layout(WIDTH, HEIGHT), argbLayout(WIDTH, HEIGHT), grayLayout(WIDTH, HEIGHT)},
+            Layout{".aligned", i420Layout(WIDTH, HEIGHT, 64, 64), argbLayout(WIDTH, HEIGHT, 64), grayLayout(WIDTH, HEIGHT, 64)}};
+        const uint32_t MAX_SIZE_I420{LAYOUTS.back().i420.size};
+        const uint32_t MAX_SIZE_ARGB{LAYOUTS.back().argb.size};
+
+        void *bufferI420{nullptr};
+        void *bufferARGB{nullptr};
+        void *bufferRow{nullptr};
+        if ( (0 != ::posix_memalign(&bufferI420, 64, MAX_SIZE_I420)) ||
+             (0 != ::posix_memalign(&bufferARGB, 64, MAX_SIZE_ARGB)) ||
+             (0 != ::posix_memalign(&bufferRow, 64, WIDTH)) ) {
+            std::cerr << "[opendlv-device-camera-opencv-benchmark]: Failed to allocate buffers." << std::endl;
+            return retCode;
+        }
+        std::unique_ptr<uint8_t, decltype(&::free)> i420(static_cast<uint8_t*>(bufferI420), &::free);
+        std::unique_ptr<uint8_t, decltype(&::free)> argb(static_cast<uint8_t*>(bufferARGB), &::free);
+        std::unique_ptr<uint8_t, decltype(&::free)> row(static_cast<uint8_t*>(bufferRow), &::free);
+
+        for (auto layout : LAYOUTS) {
+            for (auto isYUYV422 : {true, false}) {
+                if (!writesExactlyLayout(isYUYV422 ? yuyv.data() : rgb24.data(), isYUYV422, layout.i420, layout.argb)) {
+                    std::cerr << "[opendlv-device-camera-opencv-benchmark]: Conversion from " << (isYUYV422 ? "YUYV422" : "RGB24") << " at " << WIDTH << "x" << HEIGHT << " with layout '" << layout.suffix << "' misses pixels or writes out of bounds." << std::endl;
+                    pipelineFaulty = true;
+                }
+                if (!matchesI420Luma(isYUYV422 ? yuyv.data() : rgb24.data(), isYUYV422, layout.i420, layout.gray)) {
+                    std::cerr << "[opendlv-device-camera-opencv-benchmark]: Luma from " << (isYUYV422 ? "YUYV422" : "RGB24") << " at " << WIDTH << "x" << HEIGHT << " with layout '" << layout.suffix << "' differs from the I420 frame's Y plane." << std::endl;
+                    pipelineFaulty = true;
+                }
+            }
+
+            results.push_back(measure("YUY2ToI420" + layout.suffix, resolution, ITERATIONS, [&]() {
+                convertToI420(yuyv.data(), true, i420.get(), layout.i420);
+            }));
+
+            results.push_back(measure("RGB24ToI420" + layout.suffix, resolution, ITERATIONS, [&]() {
+                convertToI420(rgb24.data(), false, i420.get(), layout.i420);
+            }));
+
+            results.push_back(measure("I420ToARGB" + layout.suffix, resolution, ITERATIONS, [&]() {
+                convertI420ToARGB(i420.get(), layout.i420, argb.get(), layout.argb);
+            }));
+
+            // Luma only as published with --gray; the Y plane fits into the I420 buffer.
+            results.push_back(measure("YUY2ToY" + layout.suffix, resolution, ITERATIONS, [&]() {
+                convertToGray(yuyv.data(), true, i420.get(), layout.gray);
+            }));
+
+            results.push_back(measure("RGB24ToY" + layout.suffix, resolution, ITERATIONS, [&]() {
+                convertToGray(rgb24.data(), false, i420.get(), layout.gray);
+            }));
+
+            // Consumer copying each row of all planes into its own aligned buffer.
+            results.push_back(measure("consumer.rows.I420" + layout.suffix, resolution, ITERATIONS, [&]() {
+                const uint32_t WIDTHS[3]{layout.i420.width, chromaWidth(layout.i420.width), chromaWidth(layout.i420.width)};
+                const uint32_t HEIGHTS[3]{layout.i420.height, chromaHeight(layout.i420.height), chromaHeight(layout.i420.height)};
+                const uint32_t STRIDES[3]{layout.i420.strideY, layout.i420.strideU, layout.i420.strideV};
+                const uint32_t OFFSETS[3]{layout.i420.offsetY, layout.i420.offsetU, layout.i420.offsetV};
+                for (uint32_t plane{0}; plane < 3; plane++) {
+                    for (uint32_t y{0}; y < HEIGHTS[plane]; y++) {
+                        std::memcpy(row.get(), i420.get() + OFFSETS[plane] + y * STRIDES[plane], WIDTHS[plane]);
+                    }
+                }
+            }));
+        }
+
+        // Orientation correction: flipping is fused into the conversion while rotating needs a second pass.
+        for (auto isYUYV422 : {true, false}) {
+            const std::string FORMAT{isYUYV422 ? "YUY2ToI420" : "RGB24ToI420"};
+            const uint8_t *frame{isYUYV422 ? yuyv.data() : rgb24.data()};
+            struct Case {
+                std::string suffix;
+                uint32_t rotation;
+                bool flipVertically;
+            };
+            for (auto c : {Case{".flip", 0, true}, Case{".rotate90", 90, false}, Case{".rotate180", 180, false}}) {
+                FrameOrientation orientation{WIDTH, HEIGHT, c.rotation, false, c.flipVertically};
+                const I420Layout LAYOUT{i420Layout(orientation.width(), orientation.height())};
+                results.push_back(measure(FORMAT + c.suffix, resolution, ITERATIONS, [&]() {
+                    orientation.convertToI420(frame, isYUYV422, i420.get(), LAYOUT);
+                }));
+            }
+        }
+
+        // Pipelines specialized for the geometry against the generic one, measured alternately;
+        // both must produce identical frames.
+        {
+            FrameOrientation orientation{WIDTH, HEIGHT, 0, false, false};
+            for (auto layout : LAYOUTS) {
+                std::unique_ptr<FramePipeline> fixed{makeFramePipeline(orientation, layout.i420, layout.argb)};
+                std::unique_ptr<FramePipeline> generic{makeFramePipeline(orientation, layout.i420, layout.argb, true)};
+                if ("generic" == fixed->name()) {
+                    continue;
+                }
+                for (auto isYUYV422 : {true, false}) {
+                    const std::string FORMAT{isYUYV422 ? ".YUYV422" : ".RGB24"};
+                    const uint8_t *frame{isYUYV422 ? yuyv.data() : rgb24.data()};
+                    std::vector<uint8_t> expectedI420(layout.i420.size, 0x00);
+                    std::vector<uint8_t> expectedARGB(layout.argb.size, 0x00);
+                    generic->convertToI420(frame, isYUYV422, expectedI420.data());
+                    generic->convertToARGB(expectedI420.data(), expectedARGB.data());
+                    std::memset(i420.get(), 0x00, layout.i420.size);
+                    std::memset(argb.get(), 0x00, layout.argb.size);
+                    fixed->convertToI420(frame, isYUYV422, i420.get());
+                    fixed->convertToARGB(i420.get(), argb.get());
+                    const LumaStatistics FIXED_STATS{fixed->lumaStatistics(i420.get())};
+                    const LumaStatistics GENERIC_STATS{generic->lumaStatistics(i420.get())};
+                    if ( (0 != std::memcmp(i420.get(), expectedI420.data(), layout.i420.size)) ||
+                         (0 != std::memcmp(argb.get(), expectedARGB.data(), layout.argb.size)) ||
+                         (FIXED_STATS.samples != GENERIC_STATS.samples) ||
+                         (0 != std::memcmp(FIXED_STATS.histogram, GENERIC_STATS.histogram, sizeof(FIXED_STATS.histogram))) ) {
+                        std::cerr << "[opendlv-device-camera-opencv-benchmark]: Pipeline " << fixed->name() << " differs from the generic one for " << FORMAT.substr(1) << "." << std::endl;
+                        pipelineFaulty = true;
+                    }
+
+                    volatile float sink{0};
+                    auto run = [&](FramePipeline *p) {
+                        p->convertToI420(frame, isYUYV422, i420.get());
+                        sink = p->lumaStatistics(i420.get()).mean;
+                        p->convertToARGB(i420.get(), argb.get());
+                    };
+                    for (auto &r : measureAlternately({"pipeline.fixed" + FORMAT + layout.suffix, "pipeline.generic" + FORMAT + layout.suffix}, resolution, ITERATIONS,
+                                                      {[&]() { run(fixed.get()); }, [&]() { run(generic.get()); }})) {
+                        results.push_back(r);
+                    }
+                    (void)sink;
+                }
+            }
+        }
+
+        // Colour correction of --colour-correction applied in bands during the conversion to ARGB
+        // against separate passes over the whole frame; both must produce identical frames.
+        {
+            std::istringstream calibration{"ccm 1.5 -0.25 -0.25\nccm -0.125 1.25 -0.125\nccm 0 -0.5 1.5\ngamma 2.2\n"};
+            ColourCorrection colourCorrection{calibration, "benchmark"};
+            const Layout &layout{LAYOUTS.back()};
+            const int STRIDE{static_cast<int>(layout.argb.stride)};
+            auto convertSeparately = [&](uint8_t *dst) {
+                convertI420ToARGB(i420.get(), layout.i420, dst, layout.argb);
+                libyuv::ARGBColorMatrix(dst, STRIDE, dst, STRIDE, colourCorrection.matrix(), static_cast<int>(WIDTH), static_cast<int>(HEIGHT));
+                libyuv::ARGBColorTable(dst, STRIDE, colourCorrection.table(), 0, 0, static_cast<int>(WIDTH), static_cast<int>(HEIGHT));
+            };
+            convertToI420(rgb24.data(), false, i420.get(), layout.i420);
+            std::vector<uint8_t> expected(layout.argb.size, 0x00);
+            convertSeparately(expected.data());
+            std::memset(argb.get(), 0x00, layout.argb.size);
+            colourCorrection.convertI420ToARGB(i420.get(), layout.i420, argb.get(), layout.argb);
+            if (!colourCorrection.valid() || (0 != std::memcmp(argb.get(), expected.data(), layout.argb.size))) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: Colour correction at " << WIDTH << "x" << HEIGHT << " differs from separate passes." << std::endl;
+                pipelineFaulty = true;
+            }
+            results.push_back(measure("I420ToARGB.ccm" + layout.suffix, resolution, ITERATIONS, [&]() {
+                colourCorrection.convertI420ToARGB(i420.get(), layout.i420, argb.get(), layout.argb);
+            }));
+            results.push_back(measure("I420ToARGB.ccm.separate" + layout.suffix, resolution, ITERATIONS, [&]() {
+                convertSeparately(argb.get());
+            }));
+        }
+
+        // Composite of four cameras in 2x2 tiles as published with --composite, at full size and
+        // downscaled by 2; at full size, each tile must be an exact copy of the camera's frame.
+        {
+            const I420Layout &layout{LAYOUTS.front().i420};
+            convertToI420(rgb24.data(), false, i420.get(), layout);
+            for (auto scale : {1u, 2u}) {
+                const FrameComposite composite{WIDTH, HEIGHT, 4, 2, scale, 64, 64};
+                std::vector<uint8_t> buffer(composite.layout().size);
+                composite.clear(buffer.data());
+                results.push_back(measure("composite.2x2" + ((1 == scale) ? std::string{} : ".scale" + std::to_string(scale)), resolution, ITERATIONS, [&]() {
+                    for (uint32_t i{0}; i < 4; i++) {
+                        composite.add(i, i420.get(), layout, buffer.data());
+                    }
+                }));
+                const I420Layout TILE{composite.tile(3)};
+                bool isCopy{(TILE.width == WIDTH) && (TILE.height == HEIGHT)};
+                for (uint32_t y{0}; isCopy && (1 == scale) && (y < HEIGHT); y++) {
+                    isCopy = (0 == std::memcmp(buffer.data() + TILE.offsetY + y * TILE.strideY, i420.get() + layout.offsetY + y * layout.strideY, WIDTH)) &&
+                             (0 == std::memcmp(buffer.data() + TILE.offsetU + y / 2 * TILE.strideU, i420.get() + layout.offsetU + y / 2 * layout.strideU, chromaWidth(WIDTH))) &&
+                             (0 == std::memcmp(buffer.data() + TILE.offsetV + y / 2 * TILE.strideV, i420.get() + layout.offsetV + y / 2 * layout.strideV, chromaWidth(WIDTH)));
+                }
+                if ( (1 == scale) && !isCopy && (0 == WIDTH % 2) && (0 == HEIGHT % 2) ) {
+                    std::cerr << "[opendlv-device-camera-opencv-benchmark]: Composite at " << WIDTH << "x" << HEIGHT << " does not contain the frames as they are." << std::endl;
+                    pipelineFaulty = true;
+                }
+            }
+        }
+
+        // Change detection of --motion-gate on an unchanged frame, i.e., the cost of a skipped frame.
+        for (auto isYUYV422 : {true, false}) {
+            const uint8_t *frame{isYUYV422 ? yuyv.data() : rgb24.data()};
+            MotionGate motionGate{WIDTH, HEIGHT, isYUYV422, 4.0f, std::numeric_limits<int64_t>::max()};
+            int64_t sampleTimeStamp{0};
+            motionGate.update(frame, sampleTimeStamp, false);
+            if (motionGate.update(frame, ++sampleTimeStamp, false)) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: Motion gate at " << WIDTH << "x" << HEIGHT << " publishes an unchanged frame." << std::endl;
+                pipelineFaulty = true;
+            }
+            results.push_back(measure(std::string{"motionGate."} + (isYUYV422 ? "YUYV422" : "RGB24"), resolution, ITERATIONS, [&]() {
+                motionGate.update(frame, ++sampleTimeStamp, false);
+            }));
+        }
+
+        // Temporal denoising of --denoise for static scenes (all blocks blended) and for
+        // scenes with motion everywhere (all blocks taken unfiltered).
+        {
+            const I420Layout &layout{LAYOUTS.front().i420};
+            std::vector<uint8_t> frame(layout.size);
+            std::vector<uint16_t> accumulator(layout.size);
+            std::vector<uint8_t> referenceFrame(layout.size);
+            std::vector<uint16_t> referenceAccumulator(layout.size);
+            for (int32_t weight : {1, 32, TEMPORAL_WEIGHT_ONE}) {
+                for (std::size_t i{0}; i < layout.size; i++) {
+                    frame[i] = referenceFrame[i] = static_cast<uint8_t>((i * 13) & 0xFF);
+                    accumulator[i] = referenceAccumulator[i] = static_cast<uint16_t>((i * 771 + i / WIDTH) % 65281);
+                }
+                temporalBlend(frame.data(), accumulator.data(), layout.size, weight);
+                temporalBlendScalar(referenceFrame.data(), referenceAccumulator.data(), layout.size, weight);
+                if ( (frame != referenceFrame) || (accumulator != referenceAccumulator) ) {
+                    std::cerr << "[opendlv-device-camera-opencv-benchmark]: Temporal blending with weight " << weight << " at " << WIDTH << "x" << HEIGHT << " differs from the scalar reference." << std::endl;
+                    pipelineFaulty = true;
+                }
+            }
+
+            // A constant step of one luma value must reach the published frames even at the weakest weight.
+            for (float strength : {0.75f, 1.0f}) {
+                const GrayLayout STEP_LAYOUT{grayLayout(64, 16)};
+                std::vector<uint8_t> step(STEP_LAYOUT.size, 100);
+                TemporalDenoiser stepDenoiser{STEP_LAYOUT, strength, 12.0f};
+                stepDenoiser.apply(step.data());
+                bool hasConverged{false};
+                for (uint32_t n{0}; !hasConverged && (n < 4 * TEMPORAL_WEIGHT_ONE); n++) {
+                    std::fill(step.begin(), step.end(), 101);
+                    stepDenoiser.apply(step.data());
+                    hasConverged = std::all_of(step.begin(), step.end(), [](uint8_t v) { return 101 == v; });
+                }
+                if (!hasConverged) {
+                    std::cerr << "[opendlv-device-camera-opencv-benchmark]: Temporal denoising with strength " << strength << " does not converge to a constant step of 1." << std::endl;
+                    pipelineFaulty = true;
+                }
+            }
+
+            convertToI420(rgb24.data(), false, i420.get(), layout);
+            TemporalDenoiser denoiser{layout, 0.75f, 12.0f};
+            denoiser.apply(i420.get());
+            results.push_back(measure("denoise.I420.static", resolution, ITERATIONS, [&]() {
+                denoiser.apply(i420.get());
+            }));
+            // Moving blocks are left as they are, so two different frames can be alternated.
+            convertToI420(yuyv.data(), true, frame.data(), layout);
+            bool isOther{false};
+            results.push_back(measure("denoise.I420.moving", resolution, ITERATIONS, [&]() {
+                denoiser.apply(isOther ? frame.data() : i420.get());
+                isOther = !isOther;
+            }));
+        }
+
+        // Subsampled luma histogram as used by the software auto-exposure.
+        {
+            const I420Layout &layout{LAYOUTS.back().i420};
+            convertToI420(rgb24.data(), false, i420.get(), layout);
+            uint32_t histogram[256];
+            uint32_t reference[256];
+            const uint32_t SAMPLES{lumaHistogramScalar(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT, reference)};
+
+            // Every variant supported by this CPU is checked and measured, not only the selected one.
+            struct Variant {
+                std::string name;
+                uint32_t (*function)(const uint8_t*, uint32_t, uint32_t, uint32_t, uint32_t (&)[256]);
+            };
+            std::vector<Variant> variants{Variant{"scalar", &lumaHistogramScalar}, Variant{baselineInstructionSet(), &lumaHistogramBaseline}};
+#ifdef HAVE_X86_DISPATCH
+            if (cpuFeatures().avx2) {
+                variants.push_back(Variant{"avx2", &lumaHistogramAVX2});
+            }
+            if (cpuFeatures().avx512) {
+                variants.push_back(Variant{"avx512", &lumaHistogramAVX512});
+            }
+#endif
+
+            volatile float sink{0};
+            for (auto variant : variants) {
+                if ( (SAMPLES != variant.function(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT, histogram)) ||
+                     (0 != std::memcmp(histogram, reference, sizeof(histogram))) ) {
+                    std::cerr << "[opendlv-device-camera-opencv-benchmark]: Luma histogram (" << variant.name << ") at " << WIDTH << "x" << HEIGHT << " differs from the scalar reference." << std::endl;
+                    pipelineFaulty = true;
+                }
+                results.push_back(measure("lumaHistogram." + variant.name, resolution, ITERATIONS, [&]() {
+                    sink = static_cast<float>(variant.function(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT, histogram));
+                }));
+            }
+            results.push_back(measure("lumaStatistics", resolution, ITERATIONS, [&]() {
+                sink = lumaStatistics(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT).mean;
+            }));
+
+            // Sharpness as published with --image-quality.
+            const LaplacianSums SUMS{laplacianSums(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT)};
+            const LaplacianSums REFERENCE_SUMS{laplacianSumsScalar(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT)};
+            if ( (SUMS.samples != REFERENCE_SUMS.samples) || (SUMS.sum != REFERENCE_SUMS.sum) || (SUMS.sumOfSquares != REFERENCE_SUMS.sumOfSquares) ) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: Laplacian sums at " << WIDTH << "x" << HEIGHT << " differ from the scalar reference." << std::endl;
+                pipelineFaulty = true;
+            }
+            results.push_back(measure("lumaSharpness", resolution, ITERATIONS, [&]() {
+                sink = lumaSharpness(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT);
+            }));
+            results.push_back(measure("lumaSharpness.scalar", resolution, ITERATIONS, [&]() {
+                sink = laplacianVariance(laplacianSumsScalar(i420.get() + layout.offsetY, layout.strideY, WIDTH, HEIGHT));
+            }));
+            (void)sink;
+        }
+
+        // Full publishing cycle as done by opendlv-device-camera-opencv for each captured frame.
+        const std::string PREFIX{"opendlv-device-camera-opencv-benchmark." + std::to_string(::getpid()) + "." + std::to_string(WIDTH) + "x" + std::to_string(HEIGHT)};
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryI420(new cluon::SharedMemory{PREFIX + ".i420", sizeWithFrameMetadata(MAX_SIZE_I420)});
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryARGB(new cluon::SharedMemory{PREFIX + ".argb", sizeWithFrameMetadata(MAX_SIZE_ARGB)});
+        if ( !(sharedMemoryI420 && sharedMemoryI420->valid()) ||
+             !(sharedMemoryARGB && sharedMemoryARGB->valid()) ) {
+            std::cerr << "[opendlv-device-camera-opencv-benchmark]: Failed to create shared memory '" << PREFIX << "'." << std::endl;
+            return retCode;
+        }
+
+        FrameMetadata metadataI420;
+        FrameMetadata metadataARGB;
+        uint64_t sequenceNumber{0};
+        auto publish = [&](const uint8_t *frame, bool isYUYV422, const Layout &layout) {
+            cluon::data::TimeStamp ts{cluon::time::now()};
+            sequenceNumber++;
+            setLayout(metadataI420, layout.i420);
+            setLayout(metadataARGB, layout.argb);
+            metadataI420.sequenceNumber = metadataARGB.sequenceNumber = sequenceNumber;
+            metadataI420.sampleTimeStamp = metadataARGB.sampleTimeStamp = cluon::time::toMicroseconds(ts);
+
+            sharedMemoryI420->lock();
+            sharedMemoryI420->setTimeStamp(ts);
+            {
+                convertToI420(frame, isYUYV422, reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), layout.i420);
+                metadataI420.publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                writeFrameMetadata(sharedMemoryI420->data(), sharedMemoryI420->size(), metadataI420);
+            }
+            sharedMemoryI420->unlock();
+            sharedMemoryI420->notifyAll();
+
+            sharedMemoryARGB->lock();
+            sharedMemoryARGB->setTimeStamp(ts);
+            {
+                convertI420ToARGB(reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), layout.i420, reinterpret_cast<uint8_t*>(sharedMemoryARGB->data()), layout.argb);
+                metadataARGB.publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                writeFrameMetadata(sharedMemoryARGB->data(), sharedMemoryARGB->size(), metadataARGB);
+            }
+            sharedMemoryARGB->unlock();
+            sharedMemoryARGB->notifyAll();
+        };
+        for (auto layout : LAYOUTS) {
+            results.push_back(measure("publish.YUYV422" + layout.suffix, resolution, ITERATIONS, [&]() { publish(yuyv.data(), true, layout); }));
+            results.push_back(measure("publish.RGB24" + layout.suffix, resolution, ITERATIONS, [&]() { publish(rgb24.data(), false, layout); }));
+        }
+
+        // Publishing while all frames are recorded; the recorder copies from the I420 area on its own thread.
+        {
+            const std::string ARCHIVE{PREFIX + ".archive"};
+            const uint64_t SLOT_SIZE{sizeWithFrameMetadata(LAYOUTS.front().i420.size) + 2 * 4096u};
+            {
+                FrameArchive archive{ARCHIVE, LAYOUTS.front().i420, (ITERATIONS + 16) * SLOT_SIZE + 4096u};
+                if (!archive.valid()) {
+                    return retCode;
+                }
+                FrameRecorder recorder{archive, *sharedMemoryI420};
+                results.push_back(measure("publish.RGB24.recording", resolution, ITERATIONS, [&]() {
+                    publish(rgb24.data(), false, LAYOUTS.front());
+                    recorder.notify();
+                }));
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                std::clog << "[opendlv-device-camera-opencv-benchmark]: Recorded " << recorder.recorded() << " frames while publishing; " << recorder.dropped() << " frames were dropped." << std::endl;
+                if (0 == recorder.recorded()) {
+                    std::cerr << "[opendlv-device-camera-opencv-benchmark]: No frame was recorded." << std::endl;
+                    pipelineFaulty = true;
+                }
+            }
+
+            // Publishing the recorded frames again as fast as possible, reading them from the mapped archive.
+            {
+                FrameArchive archive{ARCHIVE};
+                if (archive.valid() && (0 < archive.header().numberOfFrames)) {
+                    FramePlayer player{archive, *sharedMemoryI420, *sharedMemoryARGB, LAYOUTS.front().argb};
+                    results.push_back(measure("play.I420", resolution, ITERATIONS, [&]() {
+                        if (!player.publishNext(false)) {
+                            player.seek(archive.indexEntry(0).sampleTimeStamp);
+                            player.publishNext(false);
+                        }
+                    }));
+                }
+            }
+            std::remove(ARCHIVE.c_str());
+        }
+
+        // Complete steady-state path of a frame through FrameSource::read and the
+        // frame pool as in the capture thread; the synthetic source runs at 1 MHz.
+        auto capture = [&](FrameSource &source, FramePool &framePool, bool isYUYV422) {
+            Frame *frame = framePool.acquire();
+            if (source.read(frame->image)) {
+                frame->sampleTimeStamp = cluon::time::now();
+                frame->captureTime = source.captureTime();
+                framePool.publish(frame);
+            }
+            else {
+                framePool.release(frame);
+            }
+
+            frame = framePool.take(std::chrono::milliseconds(100));
+            if (nullptr != frame) {
+                publish(frame->image.data, isYUYV422, LAYOUTS.front());
+                framePool.release(frame);
+            }
+        };
+        for (auto isYUYV422 : {true, false}) {
+            const std::string NAME{isYUYV422 ? "capture.YUYV422" : "capture.RGB24"};
+            SyntheticFrameSource source{WIDTH, HEIGHT, 1000.0f * 1000.0f, isYUYV422};
+            source.open();
+            FramePool framePool{3,
+                                isYUYV422 ? 1 : static_cast<int32_t>(HEIGHT),
+                                isYUYV422 ? static_cast<int32_t>(yuyv422Stride(WIDTH) * HEIGHT) : static_cast<int32_t>(WIDTH),
+                                isYUYV422 ? CV_8UC1 : CV_8UC3};
+            results.push_back(measure(NAME, resolution, ITERATIONS, [&]() { capture(source, framePool, isYUYV422); }));
+
+            // A frame of another size must be rejected without losing the preallocated buffer.
+            SyntheticFrameSource otherSource{WIDTH / 2, HEIGHT / 2, 1000.0f * 1000.0f, isYUYV422};
+            otherSource.open();
+            Frame *frame = framePool.acquire();
+            const bool IS_REJECTED{otherSource.read(frame->image) && !framePool.publish(frame) && framePool.usesPreallocatedBuffer(*frame)};
+            frame = framePool.acquire();
+            frame->discontinuity = false;
+            const bool IS_PUBLISHED{source.read(frame->image) && framePool.publish(frame)};
+            frame = framePool.take(std::chrono::milliseconds(100));
+            if (!IS_REJECTED || !IS_PUBLISHED || (nullptr == frame) || !frame->discontinuity) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: " << NAME << " did not reject a frame of another size or did not mark the next frame as discontinuity." << std::endl;
+                pipelineFaulty = true;
+            }
+            if (nullptr != frame) {
+                framePool.release(frame);
+            }
+        }
+
+        // JPEG frames sent with --jpeg-freq must fit into one UDP packet; the test pattern
+        // hardly compresses so that quality and scale have to be reduced for larger frames.
+        {
+            convertToI420(rgb24.data(), false, i420.get(), LAYOUTS.front().i420);
+            JpegCompressor compressor{LAYOUTS.front().i420, 75, JpegEncoder::MAX_MESSAGE_SIZE};
+            const uint8_t *jpeg{nullptr};
+            uint32_t jpegSize{0};
+            bool isCompressed{true};
+            results.push_back(measure(std::string{"jpeg."} + JpegCompressor::backend(), resolution, ITERATIONS, [&]() {
+                isCompressed &= compressor.compress(i420.get(), jpeg, jpegSize);
+            }));
+            const cv::Mat DECODED{isCompressed ? cv::imdecode(cv::Mat(1, static_cast<int32_t>(jpegSize), CV_8UC1, const_cast<uint8_t*>(jpeg)), cv::IMREAD_COLOR) : cv::Mat()};
+            if (!isCompressed || (jpegSize > JpegEncoder::MAX_MESSAGE_SIZE) || (static_cast<uint32_t>(DECODED.cols) != compressor.width()) || (static_cast<uint32_t>(DECODED.rows) != compressor.height())) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: JPEG frame of " << jpegSize << " bytes at " << compressor.width() << "x" << compressor.height() << " does not fit into " << JpegEncoder::MAX_MESSAGE_SIZE << " bytes or decodes to " << DECODED.cols << "x" << DECODED.rows << "." << std::endl;
+                pipelineFaulty = true;
+            }
+            std::clog << "[opendlv-device-camera-opencv-benchmark]: JPEG frames of " << WIDTH << "x" << HEIGHT << " are sent at " << compressor.width() << "x" << compressor.height() << " with quality " << compressor.quality() << " in " << jpegSize << " bytes." << std::endl;
+        }
+
+        // Pairing of two cameras as with several cameras given to --camera; the second camera
+        // lags 2 ms behind and misses every tenth frame, whose partner must be discarded and
+        // whose gap must mark the next set as discontinuity.
+        {
+            constexpr int64_t PERIOD{33333};
+            constexpr int64_t LAG{2000};
+            FramePool left{3, 1, static_cast<int32_t>(WIDTH), CV_8UC1};
+            FramePool right{3, 1, static_cast<int32_t>(WIDTH), CV_8UC1};
+            FrameSynchronizer synchronizer{{&left, &right}, PERIOD / 2};
+            auto deliver = [](FramePool &framePool, int64_t captureTime) {
+                Frame *frame = framePool.acquire();
+                frame->captureTime = captureTime;
+                frame->discontinuity = false;
+                framePool.publish(frame);
+            };
+            std::vector<Frame*> frames;
+            int64_t captureTime{0};
+            uint64_t mismatches{0};
+            uint64_t discontinuities{0};
+            results.push_back(measure("synchronizer.pairs", resolution, ITERATIONS, [&]() {
+                captureTime += PERIOD;
+                if (0 == (captureTime / PERIOD) % 10) {
+                    deliver(left, captureTime);
+                    captureTime += PERIOD;
+                }
+                deliver(left, captureTime);
+                deliver(right, captureTime + LAG);
+                if (synchronizer.take(frames, std::chrono::milliseconds(100))) {
+                    mismatches += (frames[1]->captureTime - frames[0]->captureTime != LAG) ? 1 : 0;
+                    discontinuities += (frames[0]->discontinuity || frames[1]->discontinuity) ? 1 : 0;
+                    synchronizer.release(frames);
+                }
+                else {
+                    mismatches++;
+                }
+            }));
+            if ( (0 != mismatches) || (0 == synchronizer.discarded()) || (discontinuities != synchronizer.discarded()) ) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: Frame synchronizer paired " << mismatches << " sets wrongly, discarded " << synchronizer.discarded() << " frames, and flagged " << discontinuities << " sets as discontinuity." << std::endl;
+                pipelineFaulty = true;
+            }
+        }
+
+        // Read bandwidth of a consumer attached to an ARGB area with and without huge pages;
+        // scanning along columns touches a new page for almost every access.
+        for (auto hugePages : {false, true}) {
+            const std::string SUFFIX{hugePages ? ".hugepages" : ""};
+            const uint32_t SIZE{hugePages ? roundUpToHugePages(sizeWithFrameMetadata(WIDTH * HEIGHT * 4)) : sizeWithFrameMetadata(WIDTH * HEIGHT * 4)};
+            cluon::SharedMemory producer{PREFIX + ".consumer" + SUFFIX, SIZE};
+            if (!producer.valid()) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: Failed to create shared memory '" << PREFIX << ".consumer" << SUFFIX << "'." << std::endl;
+                return retCode;
+            }
+            if (hugePages) {
+                adviseHugePages(producer.data(), producer.size());
+            }
+            prefault(producer.data(), producer.size());
+            if (hugePages && (0 == hugePageBackedBytes(producer.data()))) {
+                collapseHugePages(producer.data(), producer.size());
+            }
+
+            cluon::SharedMemory consumer{producer.name()};
+            if (!consumer.valid()) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: Failed to attach to shared memory '" << producer.name() << "'." << std::endl;
+                return retCode;
+            }
+            if (hugePages) {
+                std::clog << "[opendlv-device-camera-opencv-benchmark]: " << hugePageBackedBytes(consumer.data()) << " of " << consumer.size() << " bytes mapped by huge pages for the consumer." << std::endl;
+            }
+
+            volatile uint64_t sink{0};
+            const uint64_t *words{reinterpret_cast<const uint64_t*>(consumer.data())};
+            results.push_back(measure("consumer.read.ARGB" + SUFFIX, resolution, ITERATIONS, [&]() {
+                uint64_t sum{0};
+                for (uint32_t i{0}; i < WIDTH * HEIGHT * 4 / sizeof(uint64_t); i++) {
+                    sum += words[i];
+                }
+                sink = sum;
+            }));
+            const uint32_t *pixels{reinterpret_cast<const uint32_t*>(consumer.data())};
+            results.push_back(measure("consumer.columns.ARGB" + SUFFIX, resolution, ITERATIONS, [&]() {
+                uint64_t sum{0};
+                for (uint32_t x{0}; x < WIDTH; x += 16) {
+                    for (uint32_t y{0}; y < HEIGHT; y++) {
+                        sum += pixels[y * WIDTH + x];
+                    }
+                }
+                sink = sum;
+            }));
+            (void)sink;
+        }
+    }
+
+    // Time without frames when the camera disappears and two attempts to
+    // re-open it fail; the synthetic source delivers 100 frames per second,
+    // the frame deadline is 50 ms, and the backoff starts at 10 ms. A first
+    // frame that arrives only after the deadline must neither re-open the
+    // camera nor count as recovery.
+    {
+        using namespace std::literals::chrono_literals;
+        const Resolution RESOLUTION{640, 480};
+        const uint32_t CYCLES{std::min(ITERATIONS, 20u)};
+        SyntheticFrameSource source{RESOLUTION.width, RESOLUTION.height, 100.0f, false};
+        source.delayFirstFrame(150ms);
+        source.open();
+        CaptureSupervisor supervisor{source, 50ms, 10ms, 1000ms};
+        cv::Mat image(static_cast<int32_t>(RESOLUTION.height), static_cast<int32_t>(RESOLUTION.width), CV_8UC3);
+        bool discontinuity{false};
+        while (!supervisor.read(image, discontinuity)) {}
+        if (discontinuity || (0 != supervisor.recoveries())) {
+            std::cerr << "[opendlv-device-camera-opencv-benchmark]: A first frame after 150 ms was treated as recovery from a missed frame deadline of 50 ms." << std::endl;
+            pipelineFaulty = true;
+        }
+        std::vector<double> recoveryTimes;
+        for (uint32_t i{0}; i < CYCLES; i++) {
+            while (!supervisor.read(image, discontinuity)) {}
+            source.injectFault(2);
+            const auto TIMEOUT{std::chrono::steady_clock::now() + 5s};
+            while (!(supervisor.read(image, discontinuity) && discontinuity) && (std::chrono::steady_clock::now() < TIMEOUT)) {}
+            if (!discontinuity) {
+                std::cerr << "[opendlv-device-camera-opencv-benchmark]: Capturing did not recover from an injected fault within 5 s." << std::endl;
+                pipelineFaulty = true;
+                break;
+            }
+            recoveryTimes.push_back(static_cast<double>(supervisor.lastRecoveryTime().count()));
+        }
+        if (!recoveryTimes.empty()) {
+            results.push_back(summarize("recovery.synthetic", RESOLUTION, recoveryTimes, 0));
+        }
+    }
+
+    // Draining of a network stream delivering 100 frames per second to a consumer
+    // that is busy for 2.5 frame periods per frame: the frames that arrived in the
+    // meantime must be skipped and the newest one delivered right when it arrives.
+    // A few frames may still be stale when this process is preempted for longer
+    // than a frame period on a loaded machine; without draining, all of them are.
+    // The 50 cycles take about 1.25 s and are run independent of --iterations.
+    {
+        using namespace std::literals::chrono_literals;
+        const Resolution RESOLUTION{640, 480};
+        constexpr uint32_t CYCLES{50};
+        constexpr float FREQ{100.0f};
+        const auto PERIOD{std::chrono::duration_cast<std::chrono::steady_clock::duration>(10ms)};
+        const auto START{std::chrono::steady_clock::now()};
+        uint64_t grabbedFrames{0};
+        auto grab = [&]() {
+            // Frames that arrived already are queued; the next one has to be waited for.
+            std::this_thread::sleep_until(START + static_cast<int64_t>(grabbedFrames) * PERIOD);
+            grabbedFrames++;
+            return true;
+        };
+        uint64_t drainedFrames{0};
+        uint64_t staleFrames{0};
+        StreamLatency streamLatency;
+        std::vector<double> latencies;
+        for (uint32_t i{0}; i < CYCLES; i++) {
+            std::this_thread::sleep_for(PERIOD * 5 / 2);
+            if (!grabNewestFrame(grab, FREQ, drainedFrames)) {
+                break;
+            }
+            const auto NOW{std::chrono::steady_clock::now()};
+            const auto ARRIVAL{START + static_cast<int64_t>(grabbedFrames - 1) * PERIOD};
+            staleFrames += (NOW - ARRIVAL > PERIOD) ? 1 : 0;
+            latencies.push_back(std::chrono::duration<double, std::micro>(NOW - ARRIVAL).count());
+            streamLatency.add(std::chrono::duration<double, std::milli>(ARRIVAL - START).count(), NOW);
+        }
+        const double SPREAD{(*std::max_element(latencies.begin(), latencies.end()) - *std::min_element(latencies.begin(), latencies.end())) / 1000.0};
+        if ( (drainedFrames + latencies.size() != grabbedFrames) || (0 == drainedFrames) || (staleFrames * 10 > latencies.size()) || (streamLatency.max() > SPREAD + 0.001) ) {
+            std::cerr << "[opendlv-device-camera-opencv-benchmark]: Draining a stream skipped " << drainedFrames << " of " << grabbedFrames << " frames, delivered " << staleFrames << " stale frames, and estimated a maximum latency of " << streamLatency.max() << " ms for a spread of " << SPREAD << " ms." << std::endl;
+            pipelineFaulty = true;
+        }
+        results.push_back(summarize("stream.drain", RESOLUTION, latencies, 0));
+    }
+
+    bool capturingAllocates{false};
+    for (auto r : results) {
+        capturingAllocates |= ( (0 == r.name.find("capture.")) && (0 < r.allocationsPerFrame) );
+        std::clog << "[opendlv-device-camera-opencv-benchmark]: " << r.name << " " << r.resolution.width << "x" << r.resolution.height
+                  << ": mean = " << r.mean << " us, p50 = " << r.p50 << " us, p99 = " << r.p99 << " us, max = " << r.max << " us, "
+                  << r.allocationsPerFrame << " allocations per frame" << std::endl;
+    }
+
+    std::fstream fout(OUT, std::ios::out | std::ios::trunc);
+    if (fout.good()) {
+        fout << toJSON(LABEL, results);
+        fout.close();
+        std::clog << "[opendlv-device-camera-opencv-benchmark]: Results written to '" << OUT << "'." << std::endl;
+        retCode = 0;
+        if (capturingAllocates) {
+            std::cerr << "[opendlv-device-camera-opencv-benchmark]: Capturing allocates heap memory in steady state." << std::endl;
+            retCode = 1;
+        }
+        if (pipelineFaulty) {
+            retCode = 1;
+        }
+    }
+    else {
+        std::cerr << "[opendlv-device-camera-opencv-benchmark]: Could not write results to '" << OUT << "'." << std::endl;
+    }
+    return retCode;
+}
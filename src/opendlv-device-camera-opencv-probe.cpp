@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "frame-metadata.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Latencies recorded by one consumer; the consumer's thread appends entries and
+// publishes their number via count so that they can be reported at any time.
+struct Recording {
+    std::string name{""};
+    uint32_t consumer{0};
+    std::vector<double> notificationToWakeup{};
+    std::vector<double> captureToRead{};
+    std::atomic<std::size_t> count{0};
+    std::atomic<uint64_t> missedFrames{0};
+    std::atomic<bool> done{false};
+    std::atomic<bool> stop{false};
+};
+
+struct Percentiles {
+    double p50{0};
+    double p90{0};
+    double p99{0};
+    double p999{0};
+    double max{0};
+};
+
+Percentiles percentiles(std::vector<double> values) {
+    Percentiles retVal;
+    if (!values.empty()) {
+        std::sort(values.begin(), values.end());
+        auto at = [&values](double p) {
+            return values[static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5)];
+        };
+        retVal.p50 = at(0.5);
+        retVal.p90 = at(0.9);
+        retVal.p99 = at(0.99);
+        retVal.p999 = at(0.999);
+        retVal.max = values.back();
+    }
+    return retVal;
+}
+
+std::string toJSON(const Percentiles &p) {
+    std::stringstream sstr;
+    sstr << "{\"p50\": " << p.p50 << ", \"p90\": " << p.p90 << ", \"p99\": " << p.p99 << ", \"p99.9\": " << p.p999 << ", \"max\": " << p.max << "}";
+    return sstr.str();
+}
+
+// Wait for frames in the given shared memory area and record the latencies
+// until the requested number of frames was received.
+void consume(std::shared_ptr<Recording> recording, uint32_t frames) {
+    cluon::SharedMemory sharedMemory{recording->name};
+    if (!sharedMemory.valid()) {
+        std::cerr << "[opendlv-device-camera-opencv-probe]: Failed to attach to shared memory '" << recording->name << "'." << std::endl;
+        recording->done.store(true);
+        return;
+    }
+
+    // Read each frame completely into a local buffer as a typical consumer would do.
+    std::vector<char> buffer(sharedMemory.size());
+    uint64_t lastSequenceNumber{0};
+    while ( (recording->count.load() < frames) && !recording->stop.load() && !cluon::TerminateHandler::instance().isTerminated.load()) {
+        sharedMemory.wait();
+        const int64_t WAKEUP{cluon::time::toMicroseconds(cluon::time::now())};
+        if (recording->stop.load()) {
+            // Woken up by the main thread to stop.
+            break;
+        }
+
+        FrameMetadata metadata;
+        sharedMemory.lock();
+        const bool HAS_METADATA{readFrameMetadata(sharedMemory.data(), sharedMemory.size(), metadata)};
+        const int64_t SAMPLE_TIMESTAMP{cluon::time::toMicroseconds(sharedMemory.getTimeStamp().second)};
+        std::memcpy(buffer.data(), sharedMemory.data(), buffer.size());
+        const int64_t READ{cluon::time::toMicroseconds(cluon::time::now())};
+        sharedMemory.unlock();
+
+        if (HAS_METADATA) {
+            if ( (0 < lastSequenceNumber) && (metadata.sequenceNumber > lastSequenceNumber + 1) ) {
+                recording->missedFrames += metadata.sequenceNumber - lastSequenceNumber - 1;
+            }
+            lastSequenceNumber = metadata.sequenceNumber;
+        }
+
+        const std::size_t INDEX{recording->count.load()};
+        recording->notificationToWakeup[INDEX] = HAS_METADATA ? static_cast<double>(WAKEUP - metadata.publishTimeStamp) : 0.0;
+        recording->captureToRead[INDEX] = static_cast<double>(READ - SAMPLE_TIMESTAMP);
+        recording->count.store(INDEX + 1);
+    }
+    recording->done.store(true);
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char **argv) {
+    int32_t retCode{1};
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " attaches to the shared memory areas provided by opendlv-device-camera-opencv and measures the latency as experienced by consumers." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--name.i420=<name>] [--name.argb=<name>] [--consumers=<n>] [--frames=<n>] [--out=<file>]" << std::endl;
+        std::cerr << "         --name.i420: name of the shared memory for the I420 formatted image; when omitted, video0.i420 is chosen" << std::endl;
+        std::cerr << "         --name.argb: name of the shared memory for the ARGB formatted image; when omitted, video0.argb is chosen" << std::endl;
+        std::cerr << "         --consumers: number of concurrent consumers per shared memory area; when omitted, 1 is chosen" << std::endl;
+        std::cerr << "         --frames:    number of frames to record per consumer; when omitted, 1000 is chosen" << std::endl;
+        std::cerr << "         --out:       optional JSON file to write the results to" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --consumers=8 --frames=600 --out=probe.json" << std::endl;
+        return retCode;
+    }
+
+    const std::string NAME_I420{(commandlineArguments["name.i420"].size() != 0) ? commandlineArguments["name.i420"] : "video0.i420"};
+    const std::string NAME_ARGB{(commandlineArguments["name.argb"].size() != 0) ? commandlineArguments["name.argb"] : "video0.argb"};
+    const uint32_t CONSUMERS{(commandlineArguments["consumers"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["consumers"])) : 1};
+    const uint32_t FRAMES{(commandlineArguments["frames"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["frames"])) : 1000};
+    const std::string OUT{commandlineArguments["out"]};
+    if ( (0 == CONSUMERS) || (0 == FRAMES) ) {
+        std::cerr << "[opendlv-device-camera-opencv-probe]: consumers and frames must be larger than 0." << std::endl;
+        return retCode;
+    }
+
+    std::vector<std::shared_ptr<Recording>> recordings;
+    for (auto name : {NAME_I420, NAME_ARGB}) {
+        for (uint32_t i{0}; i < CONSUMERS; i++) {
+            auto recording = std::make_shared<Recording>();
+            recording->name = name;
+            recording->consumer = i;
+            recording->notificationToWakeup.resize(FRAMES);
+            recording->captureToRead.resize(FRAMES);
+            recordings.push_back(recording);
+        }
+    }
+
+    std::vector<std::thread> consumers;
+    for (auto recording : recordings) {
+        consumers.emplace_back(consume, recording, FRAMES);
+    }
+
+    std::clog << "[opendlv-device-camera-opencv-probe]: Recording " << FRAMES << " frames with " << CONSUMERS << " consumer(s) each for '" << NAME_I420 << "' and '" << NAME_ARGB << "'." << std::endl;
+    while (!cluon::TerminateHandler::instance().isTerminated.load()) {
+        bool allDone{true};
+        for (auto recording : recordings) {
+            allDone &= recording->done.load();
+        }
+        if (allDone) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    // Consumers still waiting for a frame (e.g., as the producer stopped) are
+    // woken up by notifying the areas from here and joined within 1 s.
+    for (auto recording : recordings) {
+        recording->stop.store(true);
+    }
+    {
+        std::vector<std::unique_ptr<cluon::SharedMemory>> notifiers;
+        for (auto name : {NAME_I420, NAME_ARGB}) {
+            notifiers.emplace_back(new cluon::SharedMemory{name});
+        }
+        const auto DEADLINE{std::chrono::steady_clock::now() + std::chrono::seconds(1)};
+        bool allDone{false};
+        while (!allDone && (std::chrono::steady_clock::now() < DEADLINE)) {
+            for (auto &notifier : notifiers) {
+                if (notifier->valid()) {
+                    notifier->notifyAll();
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            allDone = true;
+            for (auto recording : recordings) {
+                allDone &= recording->done.load();
+            }
+        }
+    }
+    bool hasBlockedConsumers{false};
+    for (std::size_t i{0}; i < consumers.size(); i++) {
+        if (recordings[i]->done.load()) {
+            consumers[i].join();
+        }
+        else {
+            hasBlockedConsumers = true;
+        }
+    }
+
+    std::stringstream json;
+    json << "{" << std::endl << "  \"consumers\": " << CONSUMERS << "," << std::endl << "  \"results\": [" << std::endl;
+    for (auto name : {NAME_I420, NAME_ARGB}) {
+        std::vector<double> allNotificationToWakeup;
+        std::vector<double> allCaptureToRead;
+        uint64_t missedFrames{0};
+        for (auto recording : recordings) {
+            if (name == recording->name) {
+                const std::size_t COUNT{recording->count.load()};
+                allNotificationToWakeup.insert(allNotificationToWakeup.end(), recording->notificationToWakeup.begin(), recording->notificationToWakeup.begin() + static_cast<std::ptrdiff_t>(COUNT));
+                allCaptureToRead.insert(allCaptureToRead.end(), recording->captureToRead.begin(), recording->captureToRead.begin() + static_cast<std::ptrdiff_t>(COUNT));
+                missedFrames += recording->missedFrames.load();
+            }
+        }
+
+        const Percentiles NOTIFICATION_TO_WAKEUP{percentiles(allNotificationToWakeup)};
+        const Percentiles CAPTURE_TO_READ{percentiles(allCaptureToRead)};
+        std::clog << "[opendlv-device-camera-opencv-probe]: '" << name << "' (" << allCaptureToRead.size() << " frames, " << missedFrames << " missed): "
+                  << "notification-to-wakeup p50/p99/max = " << NOTIFICATION_TO_WAKEUP.p50 << "/" << NOTIFICATION_TO_WAKEUP.p99 << "/" << NOTIFICATION_TO_WAKEUP.max << " us, "
+                  << "capture-to-read p50/p99/max = " << CAPTURE_TO_READ.p50 << "/" << CAPTURE_TO_READ.p99 << "/" << CAPTURE_TO_READ.max << " us" << std::endl;
+
+        json << "    {\"name\": \"" << name << "\", \"frames\": " << allCaptureToRead.size() << ", \"missed_frames\": " << missedFrames
+             << ", \"notification_to_wakeup_us\": " << toJSON(NOTIFICATION_TO_WAKEUP)
+             << ", \"capture_to_read_us\": " << toJSON(CAPTURE_TO_READ) << "}"
+             << ((name == NAME_I420) ? "," : "") << std::endl;
+    }
+    json << "  ]" << std::endl << "}" << std::endl;
+
+    retCode = 0;
+    if (!OUT.empty()) {
+        std::fstream fout(OUT, std::ios::out | std::ios::trunc);
+        if (fout.good()) {
+            fout << json.str();
+        }
+        else {
+            std::cerr << "[opendlv-device-camera-opencv-probe]: Could not write results to '" << OUT << "'." << std::endl;
+            retCode = 1;
+        }
+    }
+    if (hasBlockedConsumers) {
+        // Consumers that could not be woken up must not race with the teardown of this process.
+        std::cerr << "[opendlv-device-camera-opencv-probe]: Consumers did not stop within 1 s; exiting without cleanup." << std::endl;
+        std::cerr.flush();
+        std::clog.flush();
+        std::_Exit(retCode);
+    }
+    return retCode;
+}
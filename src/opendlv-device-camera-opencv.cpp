@@ -16,43 +16,129 @@
  */
 
 #include "cluon-complete.hpp"
-
-#include <libyuv.h>
+#include "opendlv-device-camera-opencv-messages.hpp"
+#include "auto-exposure.hpp"
+#include "camera-control.hpp"
+#include "capture-supervisor.hpp"
+#include "colour-correction.hpp"
+#include "cpu-features.hpp"
+#include "frame-archive.hpp"
+#include "frame-composite.hpp"
+#include "frame-conversion.hpp"
+#include "frame-converter.hpp"
+#include "frame-layout.hpp"
+#include "frame-metadata.hpp"
+#include "frame-orientation.hpp"
+#include "frame-pipeline.hpp"
+#include "frame-player.hpp"
+#include "frame-pool.hpp"
+#include "frame-recorder.hpp"
+#include "frame-source.hpp"
+#include "frame-synchronizer.hpp"
+#include "huge-pages.hpp"
+#include "jpeg-encoder.hpp"
+#include "luma-histogram.hpp"
+#include "luma-sharpness.hpp"
+#include "motion-gate.hpp"
+#include "realtime-scheduling.hpp"
+#include "temporal-denoiser.hpp"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 int32_t main(int32_t argc, char **argv) {
     int32_t retCode{1};
     auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
-    if ( (0 == commandlineArguments.count("camera")) ||
-         (0 == commandlineArguments.count("width")) ||
-         (0 == commandlineArguments.count("height")) ||
-         (0 == commandlineArguments.count("freq")) ) {
-        std::cerr << argv[0] << " interfaces with the given OpenCV-encapsulated camera (e.g., a V4L identifier like 0 or a stream address) and provides the captured image in two shared memory areas: one in I420 format and one in ARGB format." << std::endl;
-        std::cerr << "Usage:   " << argv[0] << " --camera=<V4L dev node> --width=<width> --height=<height> [--name.i420=<unique name for the shared memory in I420 format>] [--name.argb=<unique name for the shared memory in ARGB format>] [--yuyv422] [--verbose]" << std::endl;
-        std::cerr << "         --camera:    Camera to be used (can be a V4L identifier, e.g. 0, or a stream address)" << std::endl;
-        std::cerr << "         --name.i420: name of the shared memory for the I420 formatted image; when omitted, video0.i420 is chosen" << std::endl;
-        std::cerr << "         --name.argb: name of the shared memory for the I420 formatted image; when omitted, video0.argb is chosen" << std::endl;
+    if ( ( (0 == commandlineArguments.count("camera")) ||
+           (0 == commandlineArguments.count("width")) ||
+           (0 == commandlineArguments.count("height")) ||
+           (0 == commandlineArguments.count("freq")) ) &&
+         (0 == commandlineArguments.count("play")) ) {
+        std::cerr << argv[0] << " interfaces with the given OpenCV-encapsulated camera (e.g., a V4L identifier like 0 or a stream address, or a synthetic test pattern) and provides the captured image in two shared memory areas: one in I420 format and one in ARGB format." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --camera=<V4L dev node> --width=<width> --height=<height> [--name.i420=<unique name for the shared memory in I420 format>] [--name.argb=<unique name for the shared memory in ARGB format>] [--gray [--name.gray=<unique name for the shared memory in grayscale format>]] [--rotate=<0|90|180|270>] [--flip=<horizontal|vertical|both>] [--yuyv422] [--rt-priority=<1..99>] [--cpu-affinity=<list of CPUs>] [--huge-pages] [--layout=<packed|aligned|page-aligned>] [--generic-pipeline] [--colour-correction=<file>] [--cid=<OD4 session>] [--id=<identifier>] [--sync-tolerance=<ms>] [--composite [--name.composite=<name>] [--composite-scale=<factor>] [--composite-columns=<n>]] [--frame-deadline=<ms>] [--auto-exposure [--ae-target=<0..255>] [--ae-max-clipped=<fraction>] [--ae-max-exposure=<value>] [--ae-max-gain=<value>]] [--denoise [--denoise-strength=<0..1>] [--denoise-threshold=<luma>]] [--image-quality] [--motion-gate [--motion-threshold=<luma>] [--motion-keep-alive=<Hz>]] [--record=<file> [--record-size=<MB>]] [--jpeg-freq=<Hz> [--jpeg-quality=<1..100>]] [--verbose]" << std::endl;
+        std::cerr << "         " << argv[0] << " --play=<file> [--play-fast] [--play-loop] [--play-from=<s>] [--name.i420=<unique name for the shared memory in I420 format>] [--name.argb=<unique name for the shared memory in ARGB format>] [--layout=<packed|aligned|page-aligned>] [--rt-priority=<1..99>] [--cpu-affinity=<list of CPUs>] [--huge-pages]" << std::endl;
+        std::cerr << "         --camera:    Camera to be used (can be a V4L identifier, e.g. 0, or a stream address); synthetic delivers a moving test pattern; a comma-separated list of V4L identifiers captures these cameras in sync" << std::endl;
+        std::cerr << "         --name.i420: name of the shared memory for the I420 formatted image; when omitted, video0.i420 is chosen; with several cameras, a comma-separated list with one name per camera (default video0.i420, video1.i420, ...)" << std::endl;
+        std::cerr << "         --name.argb: name of the shared memory for the I420 formatted image; when omitted, video0.argb is chosen; with several cameras, a comma-separated list with one name per camera (default video0.argb, video1.argb, ...)" << std::endl;
+        std::cerr << "         --composite: optional: with several cameras, also publish the I420 frames of each set as tiles of one I420 frame in one shared memory area" << std::endl;
+        std::cerr << "         --name.composite: name of the shared memory for the composite; when omitted, video0.composite.i420 is chosen" << std::endl;
+        std::cerr << "         --composite-scale: optional: factor by which the frames are downscaled in the composite; when omitted, 1 is chosen" << std::endl;
+        std::cerr << "         --composite-columns: optional: number of tiles per row of the composite; when omitted, all tiles are side by side" << std::endl;
+        std::cerr << "         --sync-tolerance: optional: with several cameras, maximum difference between the capture times of the frames of a set; when omitted, half a frame period is chosen" << std::endl;
+        std::cerr << "         --gray:      optional: publish only the luma (Y) plane in one shared memory area instead of the I420 and ARGB areas" << std::endl;
+        std::cerr << "         --name.gray: name of the shared memory for the grayscale image; when omitted, video0.gray is chosen" << std::endl;
         std::cerr << "         --width:     desired width of a frame" << std::endl;
         std::cerr << "         --height:    desired height of a frame" << std::endl;
         std::cerr << "         --freq:      desired frame rate" << std::endl;
+        std::cerr << "         --rotate:    optional: rotate the captured frames clockwise by the given degrees; 90 and 270 swap width and height of the published frames" << std::endl;
+        std::cerr << "         --flip:      optional: mirror the captured frames horizontally, vertically, or both before rotating them" << std::endl;
         std::cerr << "         --yuyv422:   optional: input frame is of type YUYV422 (ie., instruct OpenCV to not convert it to RGB)" << std::endl;
+        std::cerr << "         --rt-priority:  optional: run capturing and conversion with SCHED_FIFO at the given priority and lock all pages into RAM" << std::endl;
+        std::cerr << "         --cpu-affinity: optional: pin capturing and conversion to the given CPUs (e.g., 2,3 or 2-3)" << std::endl;
+        std::cerr << "         --huge-pages:   optional: back the shared memory areas with transparent huge pages when available" << std::endl;
+        std::cerr << "         --layout:       optional: packed (default) stores all planes without padding; aligned pads rows to 64 bytes and starts planes at 64 bytes; page-aligned pads rows to 64 bytes and starts planes at 4096 bytes; offsets are relative to the start of the shared memory area" << std::endl;
+        std::cerr << "         --generic-pipeline: optional: convert with the pipeline for any geometry even if one specialized for the given width, height, and layout is available" << std::endl;
+        std::cerr << "         --cid:          optional: CID of the OD4Session to receive camera control requests (exposure, gain, white balance, frame rate) from" << std::endl;
+        std::cerr << "         --id:           optional: identifier of this camera; only control requests with this senderStamp are applied; when omitted, 0 is chosen" << std::endl;
+        std::cerr << "         --frame-deadline:   optional: re-open the camera when no frame was received for this many milliseconds; when omitted, three frame periods but at least 250 ms are chosen" << std::endl;
+        std::cerr << "         --auto-exposure:    optional: control exposure and gain from the luma histogram of the captured frames instead of the camera's auto-exposure; the histogram statistics are published in the frame metadata" << std::endl;
+        std::cerr << "         --ae-target:        optional: desired mean luma; when omitted, 110 is chosen" << std::endl;
+        std::cerr << "         --ae-max-clipped:   optional: maximum fraction of saturated pixels; when omitted, 0.01 is chosen" << std::endl;
+        std::cerr << "         --ae-max-exposure:  optional: maximum exposure in camera units; when omitted, the frame period in V4L2 units of 100us (10000/freq) is chosen" << std::endl;
+        std::cerr << "         --ae-max-gain:      optional: maximum gain in camera units; when omitted, 100 is chosen" << std::endl;
+        std::cerr << "         --colour-correction: optional: apply the colour correction matrix and per-channel lookup tables (e.g., gamma) from the given calibration file to the ARGB frames; I420 frames are published as captured" << std::endl;
+        std::cerr << "         --denoise:          optional: filter static parts of the frames recursively over time to reduce sensor noise, e.g., at night" << std::endl;
+        std::cerr << "         --denoise-strength: optional: weight of the previous frames between 0 and 1; when omitted, 0.75 is chosen" << std::endl;
+        std::cerr << "         --denoise-threshold: optional: mean absolute luma difference of a 16x16 block above which it is taken unfiltered as moving; when omitted, 12 is chosen" << std::endl;
+        std::cerr << "         --image-quality:    optional: publish the sharpness (variance of the Laplacian), mean luma, and clipped pixels of every frame in the frame metadata" << std::endl;
+        std::cerr << "         --motion-gate:      optional: neither convert nor publish frames that did not change since the last published frame" << std::endl;
+        std::cerr << "         --motion-threshold: optional: mean absolute luma difference along a row of the frame's 64x36 signature above which a frame counts as changed; when omitted, 4 is chosen" << std::endl;
+        std::cerr << "         --motion-keep-alive: optional: rate at which unchanged frames are still published (flagged as keep-alive); when omitted, 1 is chosen" << std::endl;
+        std::cerr << "         --record:           optional: record all published I420 frames with their metadata into the given preallocated archive" << std::endl;
+        std::cerr << "         --record-size:      optional: size of the archive in MB; when omitted, 1024 is chosen" << std::endl;
+        std::cerr << "         --jpeg-freq:        optional: also send the frames compressed as JPEG via the OD4Session given by --cid at this rate (opendlv.proxy.ImageReading with senderStamp --id)" << std::endl;
+        std::cerr << "         --jpeg-quality:     optional: JPEG quality; when omitted, 75 is chosen" << std::endl;
+        std::cerr << "         --play:             publish the frames of an archive recorded with --record instead of capturing; the archive determines width, height, and the I420 layout" << std::endl;
+        std::cerr << "         --play-fast:        optional: publish the recorded frames as fast as possible instead of at their recorded pace" << std::endl;
+        std::cerr << "         --play-loop:        optional: start over after the last frame" << std::endl;
+        std::cerr << "         --play-from:        optional: start with the first frame recorded this many seconds after the first frame of the archive" << std::endl;
         std::cerr << "         --verbose:   display captured image" << std::endl;
         std::cerr << "Example: " << argv[0] << " --camera=0 --width=640 --height=480 --freq=20 --verbose" << std::endl;
     } else {
-        const std::string CAMERA{commandlineArguments["camera"]};
+        // In player mode, frames are published from a recorded archive instead of a camera.
+        const std::string PLAY{commandlineArguments["play"]};
+        const bool PLAY_FAST{commandlineArguments.count("play-fast") != 0};
+        const bool PLAY_LOOP{commandlineArguments.count("play-loop") != 0};
+        const double PLAY_FROM{(commandlineArguments["play-from"].size() != 0) ? std::stod(commandlineArguments["play-from"]) : 0.0};
+        std::unique_ptr<FrameArchive> playback;
+        if (!PLAY.empty()) {
+            playback.reset(new FrameArchive{PLAY});
+            if (!playback->valid()) {
+                return retCode;
+            }
+            if (0 == playback->header().numberOfFrames) {
+                std::cerr << "[opendlv-device-camera-opencv]: '" << PLAY << "' does not contain any frames." << std::endl;
+                return retCode;
+            }
+        }
+
+        const std::string CAMERA{playback ? PLAY : commandlineArguments["camera"]};
         const std::string NAME_I420{(commandlineArguments["name.i420"].size() != 0) ? commandlineArguments["name.i420"] : "video0.i420"};
         const std::string NAME_ARGB{(commandlineArguments["name.argb"].size() != 0) ? commandlineArguments["name.argb"] : "video0.argb"};
-        const uint32_t WIDTH{static_cast<uint32_t>(std::stoi(commandlineArguments["width"]))};
-        const uint32_t HEIGHT{static_cast<uint32_t>(std::stoi(commandlineArguments["height"]))};
-        const float FREQ{static_cast<float>(std::stof(commandlineArguments["freq"]))};
+        const std::string NAME_GRAY{(commandlineArguments["name.gray"].size() != 0) ? commandlineArguments["name.gray"] : "video0.gray"};
+        const uint32_t WIDTH{playback ? playback->header().width : static_cast<uint32_t>(std::stoi(commandlineArguments["width"]))};
+        const uint32_t HEIGHT{playback ? playback->header().height : static_cast<uint32_t>(std::stoi(commandlineArguments["height"]))};
+        const float FREQ{playback ? 1.0f : static_cast<float>(std::stof(commandlineArguments["freq"]))};
         if ( !(FREQ > 0) ) {
             std::cerr << "[opendlv-device-camera-opencv]: freq must be larger than 0; found " << FREQ << "." << std::endl;
             return retCode;
@@ -60,87 +146,781 @@ int32_t main(int32_t argc, char **argv) {
 
         const bool VERBOSE{commandlineArguments.count("verbose") != 0};
         const bool IS_YUYV422{commandlineArguments.count("yuyv422") != 0};
+        const bool HUGE_PAGES{commandlineArguments.count("huge-pages") != 0};
+        const bool GRAY{commandlineArguments.count("gray") != 0};
+        const bool GENERIC_PIPELINE{commandlineArguments.count("generic-pipeline") != 0};
+        const uint32_t ROTATE{(commandlineArguments["rotate"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["rotate"])) : 0};
+        const std::string FLIP{commandlineArguments["flip"]};
+        if (!FrameOrientation::isValidRotation(ROTATE)) {
+            std::cerr << "[opendlv-device-camera-opencv]: rotate must be 0, 90, 180, or 270; found " << ROTATE << "." << std::endl;
+            return retCode;
+        }
+        if ( !FLIP.empty() && ("horizontal" != FLIP) && ("vertical" != FLIP) && ("both" != FLIP) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: flip must be horizontal, vertical, or both; found " << FLIP << "." << std::endl;
+            return retCode;
+        }
+        if (playback && ( (0 != ROTATE) || !FLIP.empty() )) {
+            std::cerr << "[opendlv-device-camera-opencv]: Recorded frames are played as recorded; --rotate and --flip cannot be used with --play." << std::endl;
+            return retCode;
+        }
+        const std::string LAYOUT{(commandlineArguments["layout"].size() != 0) ? commandlineArguments["layout"] : "packed"};
+        if ( ("packed" != LAYOUT) && ("aligned" != LAYOUT) && ("page-aligned" != LAYOUT) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: layout must be packed, aligned, or page-aligned; found " << LAYOUT << "." << std::endl;
+            return retCode;
+        }
+        // Without --rt-priority, RT_PRIORITY is 0 and the default scheduling is kept.
+        const int32_t RT_PRIORITY{(commandlineArguments["rt-priority"].size() != 0) ? std::stoi(commandlineArguments["rt-priority"]) : 0};
+        if ( (commandlineArguments["rt-priority"].size() != 0) && ( (RT_PRIORITY < 1) || (RT_PRIORITY > 99) ) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: rt-priority must be between 1 and 99; found " << RT_PRIORITY << "." << std::endl;
+            return retCode;
+        }
+        std::vector<uint32_t> cpus;
+        if ( (commandlineArguments["cpu-affinity"].size() != 0) && !parseCpuList(commandlineArguments["cpu-affinity"], cpus) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: Could not parse cpu-affinity '" << commandlineArguments["cpu-affinity"] << "'." << std::endl;
+            return retCode;
+        }
+
+        const uint32_t ID{(commandlineArguments["id"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["id"])) : 0};
+
+        const bool AUTO_EXPOSURE{commandlineArguments.count("auto-exposure") != 0};
+        const float AE_TARGET{(commandlineArguments["ae-target"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["ae-target"])) : 110.0f};
+        const float AE_MAX_CLIPPED{(commandlineArguments["ae-max-clipped"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["ae-max-clipped"])) : 0.01f};
+        // The defaults derived from the frame rate follow frame rates requested via OD4.
+        auto defaultAEMaxExposure = [](float freq) { return 10000.0f / freq; };
+        const bool HAS_AE_MAX_EXPOSURE{commandlineArguments["ae-max-exposure"].size() != 0};
+        const float AE_MAX_EXPOSURE{HAS_AE_MAX_EXPOSURE ? static_cast<float>(std::stof(commandlineArguments["ae-max-exposure"])) : defaultAEMaxExposure(FREQ)};
+        const float AE_MAX_GAIN{(commandlineArguments["ae-max-gain"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["ae-max-gain"])) : 100.0f};
+        if ( (AE_TARGET < 1.0f) || (AE_TARGET > 254.0f) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: ae-target must be between 1 and 254; found " << AE_TARGET << "." << std::endl;
+            return retCode;
+        }
 
-        cv::VideoCapture capture(CAMERA);
-        if (capture.isOpened()) {
-            capture.set(cv::CAP_PROP_FRAME_WIDTH, WIDTH);
-            capture.set(cv::CAP_PROP_FRAME_HEIGHT, HEIGHT);
-            capture.set(cv::CAP_PROP_FPS, static_cast<uint32_t>(FREQ));
+        auto defaultFrameDeadline = [](float freq) { return std::max(250, static_cast<int32_t>(3000.0f / freq)); };
+        const bool HAS_FRAME_DEADLINE{commandlineArguments["frame-deadline"].size() != 0};
+        const int32_t FRAME_DEADLINE{HAS_FRAME_DEADLINE ? std::stoi(commandlineArguments["frame-deadline"]) : defaultFrameDeadline(FREQ)};
+        if (FRAME_DEADLINE <= 0) {
+            std::cerr << "[opendlv-device-camera-opencv]: frame-deadline must be larger than 0; found " << FRAME_DEADLINE << "." << std::endl;
+            return retCode;
+        }
 
-            // Avoid using OpenCV for tranforming incoming frame to RGB as this is expensive.
-            if (IS_YUYV422) {
-                capture.set(cv::CAP_PROP_CONVERT_RGB, false);
+        const bool DENOISE{commandlineArguments.count("denoise") != 0};
+        const float DENOISE_STRENGTH{(commandlineArguments["denoise-strength"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["denoise-strength"])) : 0.75f};
+        const float DENOISE_THRESHOLD{(commandlineArguments["denoise-threshold"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["denoise-threshold"])) : 12.0f};
+        if ( (DENOISE_STRENGTH < 0.0f) || (DENOISE_STRENGTH > 1.0f) || (DENOISE_THRESHOLD < 0.0f) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: denoise-strength must be between 0 and 1 and denoise-threshold must not be negative." << std::endl;
+            return retCode;
+        }
+        if (DENOISE && playback) {
+            std::cerr << "[opendlv-device-camera-opencv]: Recorded frames are played as recorded; --denoise cannot be used with --play." << std::endl;
+            return retCode;
+        }
+        std::unique_ptr<ColourCorrection> colourCorrection;
+        if (commandlineArguments["colour-correction"].size() != 0) {
+            if (GRAY) {
+                std::cerr << "[opendlv-device-camera-opencv]: --colour-correction applies to ARGB frames, which are not published with --gray." << std::endl;
+                return retCode;
+            }
+            if (playback) {
+                std::cerr << "[opendlv-device-camera-opencv]: Recorded frames are played as recorded; --colour-correction cannot be used with --play." << std::endl;
+                return retCode;
+            }
+            colourCorrection.reset(new ColourCorrection{commandlineArguments["colour-correction"]});
+            if (!colourCorrection->valid()) {
+                return retCode;
             }
         }
-        else {
-            std::cerr << argv[0] << "Could not open camera '" << CAMERA << "'" << std::endl;
+        const bool IMAGE_QUALITY{commandlineArguments.count("image-quality") != 0};
+        const bool MOTION_GATE{commandlineArguments.count("motion-gate") != 0};
+        const float MOTION_THRESHOLD{(commandlineArguments["motion-threshold"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["motion-threshold"])) : 4.0f};
+        const float MOTION_KEEP_ALIVE{(commandlineArguments["motion-keep-alive"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["motion-keep-alive"])) : 1.0f};
+        if ( (MOTION_THRESHOLD < 0.0f) || !(MOTION_KEEP_ALIVE > 0.0f) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: motion-threshold must not be negative and motion-keep-alive must be larger than 0." << std::endl;
+            return retCode;
+        }
+        if (MOTION_GATE && playback) {
+            std::cerr << "[opendlv-device-camera-opencv]: Recorded frames are played as recorded; --motion-gate cannot be used with --play." << std::endl;
+            return retCode;
+        }
+
+        const std::string RECORD{commandlineArguments["record"]};
+        const uint64_t RECORD_SIZE{(commandlineArguments["record-size"].size() != 0) ? static_cast<uint64_t>(std::stoull(commandlineArguments["record-size"])) : 1024};
+
+        const float JPEG_FREQ{(commandlineArguments["jpeg-freq"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["jpeg-freq"])) : 0.0f};
+        const int32_t JPEG_QUALITY{(commandlineArguments["jpeg-quality"].size() != 0) ? std::stoi(commandlineArguments["jpeg-quality"]) : 75};
+        if ( (JPEG_FREQ < 0.0f) || ( (JPEG_FREQ > 0.0f) && (0 == commandlineArguments["cid"].size()) ) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: jpeg-freq must be larger than 0 and requires --cid." << std::endl;
+            return retCode;
+        }
+        if ( (JPEG_QUALITY < 1) || (JPEG_QUALITY > 100) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: jpeg-quality must be between 1 and 100; found " << JPEG_QUALITY << "." << std::endl;
+            return retCode;
+        }
+
+        if (GRAY && (playback || !RECORD.empty() || (JPEG_FREQ > 0.0f))) {
+            std::cerr << "[opendlv-device-camera-opencv]: --gray cannot be combined with --play, --record, or --jpeg-freq as they require I420 frames." << std::endl;
+            return retCode;
+        }
+
+        if (IS_YUYV422 && isNetworkStream(CAMERA)) {
+            std::cerr << "[opendlv-device-camera-opencv]: Network streams are decoded to RGB24; --yuyv422 cannot be used with '" << CAMERA << "'." << std::endl;
             return retCode;
         }
 
-        std::unique_ptr<cluon::SharedMemory> sharedMemoryI420(new cluon::SharedMemory{NAME_I420, WIDTH * HEIGHT * 3/2});
-        if (!sharedMemoryI420 || !sharedMemoryI420->valid()) {
-            std::cerr << "[opendlv-device-camera-opencv]: Failed to create shared memory '" << NAME_I420 << "'." << std::endl;
+        // Several cameras are captured in sync and their frames are published as sets with one sequence number.
+        // stringtoolbox::split returns nothing for a string without delimiter, i.e., for a single camera.
+        const std::vector<std::string> CAMERAS{(playback || isNetworkStream(CAMERA) || (std::string::npos == CAMERA.find(','))) ? std::vector<std::string>{CAMERA} : stringtoolbox::split(CAMERA, ',')};
+        const bool MULTI_CAMERA{1 < CAMERAS.size()};
+        const float SYNC_TOLERANCE{(commandlineArguments["sync-tolerance"].size() != 0) ? static_cast<float>(std::stof(commandlineArguments["sync-tolerance"])) : 500.0f / FREQ};
+        const bool COMPOSITE{commandlineArguments.count("composite") != 0};
+        const std::string NAME_COMPOSITE{(commandlineArguments["name.composite"].size() != 0) ? commandlineArguments["name.composite"] : "video0.composite.i420"};
+        const uint32_t COMPOSITE_SCALE{(commandlineArguments["composite-scale"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["composite-scale"])) : 1};
+        const uint32_t COMPOSITE_COLUMNS{(commandlineArguments["composite-columns"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["composite-columns"])) : static_cast<uint32_t>(CAMERAS.size())};
+        if (COMPOSITE && !MULTI_CAMERA) {
+            std::cerr << "[opendlv-device-camera-opencv]: --composite requires several cameras in --camera." << std::endl;
+            return retCode;
+        }
+        if ( (COMPOSITE_SCALE < 1) || (COMPOSITE_SCALE > 16) || (COMPOSITE_COLUMNS < 1) ) {
+            std::cerr << "[opendlv-device-camera-opencv]: composite-scale must be between 1 and 16 and composite-columns must be larger than 0." << std::endl;
             return retCode;
         }
+        std::vector<std::string> namesI420;
+        std::vector<std::string> namesARGB;
+        if (MULTI_CAMERA) {
+            if (GRAY || !RECORD.empty() || (JPEG_FREQ > 0.0f) || AUTO_EXPOSURE || DENOISE || MOTION_GATE || colourCorrection || (0 != commandlineArguments["cid"].size())) {
+                std::cerr << "[opendlv-device-camera-opencv]: --gray, --record, --jpeg-freq, --auto-exposure, --denoise, --motion-gate, --colour-correction, and --cid cannot be used with several cameras." << std::endl;
+                return retCode;
+            }
+            if (SYNC_TOLERANCE < 0.0f) {
+                std::cerr << "[opendlv-device-camera-opencv]: sync-tolerance must not be negative; found " << SYNC_TOLERANCE << "." << std::endl;
+                return retCode;
+            }
+            namesI420 = stringtoolbox::split(commandlineArguments["name.i420"], ',');
+            namesARGB = stringtoolbox::split(commandlineArguments["name.argb"], ',');
+            for (std::size_t i{0}; (i < CAMERAS.size()) && (commandlineArguments["name.i420"].size() == 0); i++) {
+                namesI420.push_back("video" + std::to_string(i) + ".i420");
+            }
+            for (std::size_t i{0}; (i < CAMERAS.size()) && (commandlineArguments["name.argb"].size() == 0); i++) {
+                namesARGB.push_back("video" + std::to_string(i) + ".argb");
+            }
+            if ( (namesI420.size() != CAMERAS.size()) || (namesARGB.size() != CAMERAS.size()) ) {
+                std::cerr << "[opendlv-device-camera-opencv]: name.i420 and name.argb must list one name for each of the " << CAMERAS.size() << " cameras." << std::endl;
+                return retCode;
+            }
+        }
 
-        std::unique_ptr<cluon::SharedMemory> sharedMemoryARGB(new cluon::SharedMemory{NAME_ARGB, WIDTH * HEIGHT * 4});
-        if (!sharedMemoryARGB || !sharedMemoryARGB->valid()) {
-            std::cerr << "[opendlv-device-camera-opencv]: Failed to create shared memory '" << NAME_ARGB << "'." << std::endl;
+        std::unique_ptr<FrameSource> capture;
+        std::vector<std::unique_ptr<FrameSource>> captures;
+        // Network streams report their latency and the number of drained frames.
+        OpenCVFrameSource *networkStream{nullptr};
+        if (playback) {
+            std::clog << "[opendlv-device-camera-opencv]: Playing " << playback->header().numberOfFrames << " frames of " << WIDTH << "x" << HEIGHT << " from '" << PLAY << "'." << std::endl;
+        }
+        else if (MULTI_CAMERA) {
+            for (auto camera : CAMERAS) {
+                if ("synthetic" == camera) {
+                    captures.emplace_back(new SyntheticFrameSource{WIDTH, HEIGHT, FREQ, IS_YUYV422});
+                }
+                else {
+                    captures.emplace_back(new OpenCVFrameSource{camera, WIDTH, HEIGHT, FREQ, IS_YUYV422, FRAME_DEADLINE});
+                }
+                if (!captures.back()->open()) {
+                    std::cerr << "[opendlv-device-camera-opencv]: Could not open camera '" << camera << "'." << std::endl;
+                    return retCode;
+                }
+            }
+        }
+        else if ("synthetic" == CAMERA) {
+            capture.reset(new SyntheticFrameSource{WIDTH, HEIGHT, FREQ, IS_YUYV422});
+        }
+        else {
+            OpenCVFrameSource *source{new OpenCVFrameSource{CAMERA, WIDTH, HEIGHT, FREQ, IS_YUYV422, FRAME_DEADLINE}};
+            capture.reset(source);
+            networkStream = isNetworkStream(CAMERA) ? source : nullptr;
+        }
+        if (capture && !capture->open()) {
+            std::cerr << argv[0] << "Could not open camera '" << CAMERA << "'" << std::endl;
             return retCode;
         }
 
-        if ( (sharedMemoryI420 && sharedMemoryI420->valid()) &&
-             (sharedMemoryARGB && sharedMemoryARGB->valid()) ) {
-            std::clog << "[opendlv-device-camera-opencv]: Data from camera '" << CAMERA<< "' available in I420 format in shared memory '" << sharedMemoryI420->name() << "' (" << sharedMemoryI420->size() << ") and in ARGB format in shared memory '" << sharedMemoryARGB->name() << "' (" << sharedMemoryARGB->size() << ")." << std::endl;
+        // Orientation is corrected while converting; the published frames have the rotated size.
+        FrameOrientation orientation{WIDTH, HEIGHT, ROTATE, ("horizontal" == FLIP) || ("both" == FLIP), ("vertical" == FLIP) || ("both" == FLIP)};
+        const uint32_t OUTPUT_WIDTH{orientation.width()};
+        const uint32_t OUTPUT_HEIGHT{orientation.height()};
+
+        // The layout of the planes is described in the metadata at the end of each shared memory area.
+        const uint32_t STRIDE_ALIGNMENT{("packed" == LAYOUT) ? 1u : 64u};
+        const uint32_t PLANE_ALIGNMENT{("packed" == LAYOUT) ? 1u : (("aligned" == LAYOUT) ? 64u : 4096u)};
+        const I420Layout LAYOUT_I420{playback ? i420Layout(playback->header()) : i420Layout(OUTPUT_WIDTH, OUTPUT_HEIGHT, STRIDE_ALIGNMENT, PLANE_ALIGNMENT)};
+        const ARGBLayout LAYOUT_ARGB{argbLayout(OUTPUT_WIDTH, OUTPUT_HEIGHT, STRIDE_ALIGNMENT)};
+        const GrayLayout LAYOUT_GRAY{grayLayout(OUTPUT_WIDTH, OUTPUT_HEIGHT, STRIDE_ALIGNMENT)};
 
-            cv::Mat ARGB(HEIGHT, WIDTH, CV_8UC4, sharedMemoryARGB->data());
+        // With huge pages, the areas are padded to full huge pages; the metadata is always at the end.
+        const uint32_t SIZE_I420{HUGE_PAGES ? roundUpToHugePages(sizeWithFrameMetadata(LAYOUT_I420.size)) : sizeWithFrameMetadata(LAYOUT_I420.size)};
+        const uint32_t SIZE_ARGB{HUGE_PAGES ? roundUpToHugePages(sizeWithFrameMetadata(LAYOUT_ARGB.size)) : sizeWithFrameMetadata(LAYOUT_ARGB.size)};
+        const uint32_t SIZE_GRAY{HUGE_PAGES ? roundUpToHugePages(sizeWithFrameMetadata(LAYOUT_GRAY.size)) : sizeWithFrameMetadata(LAYOUT_GRAY.size)};
 
+        // With --gray, only the Y plane is published in its own area and neither chroma nor ARGB are computed.
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryI420;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryARGB;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryGray;
+        std::vector<cluon::SharedMemory*> sharedMemories;
+        // With several cameras, each camera has its own I420 and ARGB areas.
+        std::vector<std::unique_ptr<cluon::SharedMemory>> sharedMemoriesI420;
+        std::vector<std::unique_ptr<cluon::SharedMemory>> sharedMemoriesARGB;
+        // The composite is published in addition to the areas of the cameras.
+        const FrameComposite composite{OUTPUT_WIDTH, OUTPUT_HEIGHT, static_cast<uint32_t>(CAMERAS.size()), COMPOSITE_COLUMNS, COMPOSITE_SCALE, STRIDE_ALIGNMENT, PLANE_ALIGNMENT};
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryComposite;
+        if (COMPOSITE) {
+            const uint32_t SIZE_COMPOSITE{HUGE_PAGES ? roundUpToHugePages(sizeWithFrameMetadata(composite.layout().size)) : sizeWithFrameMetadata(composite.layout().size)};
+            sharedMemoryComposite.reset(new cluon::SharedMemory{NAME_COMPOSITE, SIZE_COMPOSITE});
+            if (!sharedMemoryComposite->valid()) {
+                std::cerr << "[opendlv-device-camera-opencv]: Failed to create shared memory '" << NAME_COMPOSITE << "'." << std::endl;
+                return retCode;
+            }
+            sharedMemories.push_back(sharedMemoryComposite.get());
+        }
+        if (MULTI_CAMERA) {
+            for (std::size_t i{0}; i < CAMERAS.size(); i++) {
+                sharedMemoriesI420.emplace_back(new cluon::SharedMemory{namesI420[i], SIZE_I420});
+                sharedMemoriesARGB.emplace_back(new cluon::SharedMemory{namesARGB[i], SIZE_ARGB});
+                for (auto sharedMemory : {sharedMemoriesI420.back().get(), sharedMemoriesARGB.back().get()}) {
+                    if (!sharedMemory->valid()) {
+                        std::cerr << "[opendlv-device-camera-opencv]: Failed to create shared memory '" << sharedMemory->name() << "'." << std::endl;
+                        return retCode;
+                    }
+                    sharedMemories.push_back(sharedMemory);
+                }
+            }
+        }
+        else if (GRAY) {
+            sharedMemoryGray.reset(new cluon::SharedMemory{NAME_GRAY, SIZE_GRAY});
+            if (!sharedMemoryGray || !sharedMemoryGray->valid()) {
+                std::cerr << "[opendlv-device-camera-opencv]: Failed to create shared memory '" << NAME_GRAY << "'." << std::endl;
+                return retCode;
+            }
+            sharedMemories.push_back(sharedMemoryGray.get());
+        }
+        else {
+            sharedMemoryI420.reset(new cluon::SharedMemory{NAME_I420, SIZE_I420});
+            if (!sharedMemoryI420 || !sharedMemoryI420->valid()) {
+                std::cerr << "[opendlv-device-camera-opencv]: Failed to create shared memory '" << NAME_I420 << "'." << std::endl;
+                return retCode;
+            }
+
+            sharedMemoryARGB.reset(new cluon::SharedMemory{NAME_ARGB, SIZE_ARGB});
+            if (!sharedMemoryARGB || !sharedMemoryARGB->valid()) {
+                std::cerr << "[opendlv-device-camera-opencv]: Failed to create shared memory '" << NAME_ARGB << "'." << std::endl;
+                return retCode;
+            }
+            sharedMemories.push_back(sharedMemoryI420.get());
+            sharedMemories.push_back(sharedMemoryARGB.get());
+        }
+
+        if (!sharedMemories.empty()) {
+            if (MULTI_CAMERA) {
+                for (std::size_t i{0}; i < CAMERAS.size(); i++) {
+                    std::clog << "[opendlv-device-camera-opencv]: Data from camera '" << CAMERAS[i] << "' available in I420 format in shared memory '" << sharedMemoriesI420[i]->name() << "' (" << sharedMemoriesI420[i]->size() << ") and in ARGB format in shared memory '" << sharedMemoriesARGB[i]->name() << "' (" << sharedMemoriesARGB[i]->size() << ")." << std::endl;
+                }
+                if (sharedMemoryComposite) {
+                    std::clog << "[opendlv-device-camera-opencv]: Data from all cameras available as " << composite.columns() << "x" << composite.rows() << " tiles of " << composite.tile(0).width << "x" << composite.tile(0).height << " in I420 format in shared memory '" << sharedMemoryComposite->name() << "' (" << sharedMemoryComposite->size() << ")." << std::endl;
+                }
+            }
+            else if (GRAY) {
+                std::clog << "[opendlv-device-camera-opencv]: Data from camera '" << CAMERA<< "' available in grayscale format in shared memory '" << sharedMemoryGray->name() << "' (" << sharedMemoryGray->size() << ")." << std::endl;
+            }
+            else {
+                std::clog << "[opendlv-device-camera-opencv]: Data from camera '" << CAMERA<< "' available in I420 format in shared memory '" << sharedMemoryI420->name() << "' (" << sharedMemoryI420->size() << ") and in ARGB format in shared memory '" << sharedMemoryARGB->name() << "' (" << sharedMemoryARGB->size() << ")." << std::endl;
+            }
+
+            // Planes are aligned relative to data(), which follows cluon's header with POSIX shared memory.
+            if (1 < PLANE_ALIGNMENT) {
+                for (auto sharedMemory : sharedMemories) {
+                    const uintptr_t MISALIGNMENT{reinterpret_cast<uintptr_t>(sharedMemory->data()) % PLANE_ALIGNMENT};
+                    if (0 != MISALIGNMENT) {
+                        std::cerr << "[opendlv-device-camera-opencv]: Shared memory '" << sharedMemory->name() << "' starts " << MISALIGNMENT << " bytes after a " << PLANE_ALIGNMENT << " byte boundary (e.g., with CLUON_SHAREDMEMORY_POSIX=1); planes are aligned relative to its start only." << std::endl;
+                    }
+                }
+            }
+
+            // Huge pages must be requested before the pages are touched for the first time.
+            if (HUGE_PAGES) {
+                for (auto sharedMemory : sharedMemories) {
+                    adviseHugePages(sharedMemory->data(), sharedMemory->size());
+                }
+            }
+
+            // Avoid page faults in the shared memory areas while capturing.
+            for (auto sharedMemory : sharedMemories) {
+                prefault(sharedMemory->data(), sharedMemory->size());
+            }
+
+            if (HUGE_PAGES) {
+                for (auto sharedMemory : sharedMemories) {
+                    uint64_t hugePageBytes{hugePageBackedBytes(sharedMemory->data())};
+                    if (hugePageBytes < sharedMemory->size() / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE) {
+                        // Pages might have been touched already (e.g., mlock'ed by the POSIX implementation).
+                        collapseHugePages(sharedMemory->data(), sharedMemory->size());
+                        hugePageBytes = hugePageBackedBytes(sharedMemory->data());
+                    }
+                    if (0 == hugePageBytes) {
+                        std::cerr << "[opendlv-device-camera-opencv]: Huge pages are not available for '" << sharedMemory->name() << "'; using regular pages (check /sys/kernel/mm/transparent_hugepage/shmem_enabled)." << std::endl;
+                    }
+                    else {
+                        std::clog << "[opendlv-device-camera-opencv]: " << hugePageBytes << " of " << sharedMemory->size() << " bytes of '" << sharedMemory->name() << "' are backed by huge pages." << std::endl;
+                    }
+                }
+            }
+            if (0 < RT_PRIORITY) {
+                // mlockall(MCL_CURRENT) would read in the complete recording; it is mapped again afterwards (cf. FrameArchive).
+                playback.reset();
+                lockMemory();
+                if (!PLAY.empty()) {
+                    playback.reset(new FrameArchive{PLAY});
+                    if (!playback->valid()) {
+                        return retCode;
+                    }
+                    if ( (WIDTH != playback->header().width) || (HEIGHT != playback->header().height) || (LAYOUT_I420.size != playback->header().frameSize) ) {
+                        std::cerr << "[opendlv-device-camera-opencv]: '" << PLAY << "' was replaced while starting." << std::endl;
+                        return retCode;
+                    }
+                }
+            }
+
+            if (playback) {
+                applyRealtimeScheduling("player thread", RT_PRIORITY, cpus);
+                FramePlayer player{*playback, *sharedMemoryI420, *sharedMemoryARGB, LAYOUT_ARGB};
+                const int64_t FIRST{playback->indexEntry(0).sampleTimeStamp};
+                if (!player.seek(FIRST + static_cast<int64_t>(PLAY_FROM * 1000.0 * 1000.0))) {
+                    std::cerr << "[opendlv-device-camera-opencv]: '" << PLAY << "' ends before " << PLAY_FROM << " s." << std::endl;
+                    return retCode;
+                }
+                const uint64_t START{player.position()};
+                while (!cluon::TerminateHandler::instance().isTerminated.load()) {
+                    if (!player.publishNext(!PLAY_FAST)) {
+                        if (!PLAY_LOOP) {
+                            break;
+                        }
+                        player.seek(playback->indexEntry(START).sampleTimeStamp);
+                    }
+                }
+                retCode = 0;
+                return retCode;
+            }
+
+            if (MULTI_CAMERA) {
+                // Each camera is captured by its own thread into its own frame pool; the
+                // conversion thread takes complete sets of frames from all pools.
+                constexpr uint32_t NUMBER_OF_FRAMES{3};
+                std::vector<std::unique_ptr<FramePool>> framePools;
+                std::vector<FramePool*> pools;
+                for (std::size_t i{0}; i < CAMERAS.size(); i++) {
+                    framePools.emplace_back(new FramePool{NUMBER_OF_FRAMES,
+                                                          IS_YUYV422 ? 1 : static_cast<int32_t>(HEIGHT),
+                                                          IS_YUYV422 ? static_cast<int32_t>(yuyv422Stride(WIDTH) * HEIGHT) : static_cast<int32_t>(WIDTH),
+                                                          IS_YUYV422 ? CV_8UC1 : CV_8UC3});
+                    if (!framePools.back()->valid()) {
+                        std::cerr << "[opendlv-device-camera-opencv]: Failed to allocate frame buffers." << std::endl;
+                        return retCode;
+                    }
+                    pools.push_back(framePools.back().get());
+                }
+
+                std::vector<std::thread> captureThreads;
+                for (std::size_t i{0}; i < CAMERAS.size(); i++) {
+                    captureThreads.emplace_back([&capture = *captures[i], &framePool = *framePools[i], FRAME_DEADLINE, RT_PRIORITY, &cpus]() {
+                        applyRealtimeScheduling("capture thread", RT_PRIORITY, cpus);
+                        CaptureSupervisor supervisor{capture, std::chrono::milliseconds(FRAME_DEADLINE), std::chrono::milliseconds(50), std::chrono::milliseconds(2000)};
+                        bool hasReportedReallocation{false};
+                        while (!cluon::TerminateHandler::instance().isTerminated.load()) {
+                            Frame *frame = framePool.acquire();
+                            bool discontinuity{false};
+                            if (supervisor.read(frame->image, discontinuity)) {
+                                frame->sampleTimeStamp = cluon::time::now();
+                                frame->captureTime = capture.captureTime();
+                                frame->discontinuity = discontinuity;
+                                if (!hasReportedReallocation && !framePool.usesPreallocatedBuffer(*frame)) {
+                                    std::cerr << "[opendlv-device-camera-opencv]: Camera delivers frames of " << frame->image.cols << "x" << frame->image.rows << " with type " << frame->image.type() << " instead of the preallocated format; these frames are dropped." << std::endl;
+                                    hasReportedReallocation = true;
+                                }
+                                framePool.publish(frame);
+                            }
+                            else {
+                                framePool.release(frame);
+                            }
+                        }
+                    });
+                }
+                applyRealtimeScheduling("conversion thread", RT_PRIORITY, cpus);
+
+                std::unique_ptr<FramePipeline> pipeline{makeFramePipeline(orientation, LAYOUT_I420, LAYOUT_ARGB, GENERIC_PIPELINE)};
+                std::clog << "[opendlv-device-camera-opencv]: Converting sets of " << CAMERAS.size() << " frames captured at most " << SYNC_TOLERANCE << " ms apart with the " << pipeline->name() << " pipeline." << std::endl;
+
+                FrameSynchronizer synchronizer{pools, static_cast<int64_t>(SYNC_TOLERANCE * 1000.0f)};
+                std::vector<std::unique_ptr<FrameConverter>> converters;
+                for (std::size_t i{0}; i < CAMERAS.size(); i++) {
+                    converters.emplace_back(new FrameConverter{*pipeline, IS_YUYV422, LAYOUT_I420, LAYOUT_ARGB, IMAGE_QUALITY, IMAGE_QUALITY, nullptr, nullptr});
+                    converters[i]->metadataI420().cameraIndex = converters[i]->metadataARGB().cameraIndex = static_cast<uint32_t>(i);
+                    converters[i]->metadataI420().numberOfCameras = converters[i]->metadataARGB().numberOfCameras = static_cast<uint32_t>(CAMERAS.size());
+                }
+                // Each set is also published in the composite with one lock, one time stamp, and one notification.
+                FrameMetadata metadataComposite;
+                setLayout(metadataComposite, composite.layout());
+                metadataComposite.numberOfCameras = static_cast<uint32_t>(CAMERAS.size());
+                metadataComposite.tileColumns = composite.columns();
+                metadataComposite.tileRows = composite.rows();
+                if (sharedMemoryComposite) {
+                    composite.clear(reinterpret_cast<uint8_t*>(sharedMemoryComposite->data()));
+                }
+                uint64_t sequenceNumber{0};
+                uint32_t discontinuities{0};
+                std::vector<Frame*> frames;
+                while (!cluon::TerminateHandler::instance().isTerminated.load()) {
+                    if (!synchronizer.take(frames, std::chrono::milliseconds(100))) {
+                        continue;
+                    }
+                    sequenceNumber++;
+                    bool discontinuity{false};
+                    for (auto frame : frames) {
+                        discontinuity |= frame->discontinuity;
+                    }
+                    discontinuities += discontinuity ? 1 : 0;
+
+                    // All areas of a set are locked while any of them is written and the
+                    // consumers are notified only after all of them were unlocked.
+                    for (std::size_t i{0}; i < frames.size(); i++) {
+                        converters[i]->setFrame(*frames[i], sequenceNumber, discontinuity ? FrameMetadata::FLAG_DISCONTINUITY : 0, discontinuities, static_cast<uint32_t>(synchronizer.spread()));
+                        sharedMemoriesI420[i]->lock();
+                        sharedMemoriesI420[i]->setTimeStamp(frames[i]->sampleTimeStamp);
+                        converters[i]->convertToI420(*frames[i], reinterpret_cast<uint8_t*>(sharedMemoriesI420[i]->data()));
+                    }
+                    // The composite is filled from the I420 areas while they are still locked and
+                    // carries the time stamps of the earliest frame of the set.
+                    if (sharedMemoryComposite) {
+                        std::size_t earliest{0};
+                        for (std::size_t i{1}; i < frames.size(); i++) {
+                            earliest = (frames[i]->captureTime < frames[earliest]->captureTime) ? i : earliest;
+                        }
+                        metadataComposite.sequenceNumber = sequenceNumber;
+                        metadataComposite.flags = discontinuity ? FrameMetadata::FLAG_DISCONTINUITY : 0;
+                        metadataComposite.discontinuities = discontinuities;
+                        metadataComposite.sampleTimeStamp = converters[earliest]->metadataI420().sampleTimeStamp;
+                        metadataComposite.captureTimeStamp = converters[earliest]->metadataI420().captureTimeStamp;
+                        metadataComposite.syncSpread = converters[earliest]->metadataI420().syncSpread;
+
+                        sharedMemoryComposite->lock();
+                        sharedMemoryComposite->setTimeStamp(cluon::time::fromMicroseconds(metadataComposite.sampleTimeStamp));
+                        for (std::size_t i{0}; i < sharedMemoriesI420.size(); i++) {
+                            composite.add(static_cast<uint32_t>(i), reinterpret_cast<uint8_t*>(sharedMemoriesI420[i]->data()), LAYOUT_I420, reinterpret_cast<uint8_t*>(sharedMemoryComposite->data()));
+                        }
+                        metadataComposite.publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                        writeFrameMetadata(sharedMemoryComposite->data(), sharedMemoryComposite->size(), metadataComposite);
+                        sharedMemoryComposite->unlock();
+                    }
+                    for (std::size_t i{0}; i < frames.size(); i++) {
+                        converters[i]->metadataI420().publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                        writeFrameMetadata(sharedMemoriesI420[i]->data(), sharedMemoriesI420[i]->size(), converters[i]->metadataI420());
+                        sharedMemoriesI420[i]->unlock();
+                    }
+                    for (auto &sharedMemory : sharedMemoriesI420) {
+                        sharedMemory->notifyAll();
+                    }
+                    if (sharedMemoryComposite) {
+                        sharedMemoryComposite->notifyAll();
+                    }
+                    synchronizer.release(frames);
+
+                    for (std::size_t i{0}; i < sharedMemoriesARGB.size(); i++) {
+                        sharedMemoriesARGB[i]->lock();
+                        sharedMemoriesARGB[i]->setTimeStamp(cluon::time::fromMicroseconds(converters[i]->metadataARGB().sampleTimeStamp));
+                        converters[i]->convertToARGB(reinterpret_cast<uint8_t*>(sharedMemoriesI420[i]->data()), reinterpret_cast<uint8_t*>(sharedMemoriesARGB[i]->data()));
+                        if (VERBOSE) {
+                            cv::imshow(sharedMemoriesARGB[i]->name(), cv::Mat(OUTPUT_HEIGHT, OUTPUT_WIDTH, CV_8UC4, sharedMemoriesARGB[i]->data(), LAYOUT_ARGB.stride));
+                        }
+                    }
+                    for (std::size_t i{0}; i < sharedMemoriesARGB.size(); i++) {
+                        converters[i]->metadataARGB().publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                        writeFrameMetadata(sharedMemoriesARGB[i]->data(), sharedMemoriesARGB[i]->size(), converters[i]->metadataARGB());
+                        sharedMemoriesARGB[i]->unlock();
+                    }
+                    for (auto &sharedMemory : sharedMemoriesARGB) {
+                        sharedMemory->notifyAll();
+                    }
+                    if (VERBOSE) {
+                        cv::waitKey(10); // Necessary to actually display the images.
+                    }
+                }
+                for (auto &captureThread : captureThreads) {
+                    captureThread.join();
+                }
+                std::clog << "[opendlv-device-camera-opencv]: Published " << sequenceNumber << " sets of frames; " << synchronizer.discarded() << " frames were discarded without a matching frame of the other cameras." << std::endl;
+                for (auto &c : captures) {
+                    c->release();
+                }
+                retCode = 0;
+                return retCode;
+            }
+
+            // Frames are captured into preallocated buffers by a separate thread
+            // and converted here; OpenCV delivers raw YUYV422 frames as one row.
+            constexpr uint32_t NUMBER_OF_FRAMES{3};
+            FramePool framePool{NUMBER_OF_FRAMES,
+                                IS_YUYV422 ? 1 : static_cast<int32_t>(HEIGHT),
+                                IS_YUYV422 ? static_cast<int32_t>(yuyv422Stride(WIDTH) * HEIGHT) : static_cast<int32_t>(WIDTH),
+                                IS_YUYV422 ? CV_8UC1 : CV_8UC3};
+            if (!framePool.valid()) {
+                std::cerr << "[opendlv-device-camera-opencv]: Failed to allocate frame buffers." << std::endl;
+                return retCode;
+            }
+
+            // Published I420 frames are copied into the archive by a separate thread.
+            std::unique_ptr<FrameArchive> archive;
+            std::unique_ptr<FrameRecorder> recorder;
+            if (!RECORD.empty()) {
+                archive.reset(new FrameArchive{RECORD, LAYOUT_I420, RECORD_SIZE * 1024 * 1024});
+                if (!archive->valid()) {
+                    return retCode;
+                }
+                recorder.reset(new FrameRecorder{*archive, *sharedMemoryI420});
+                std::clog << "[opendlv-device-camera-opencv]: Recording to '" << RECORD << "' with room for " << archive->header().capacity << " frames (" << archive->header().capacity / FREQ << " s)." << std::endl;
+            }
+
+            // Control requests are received via OD4 and applied by the capture thread between two frames.
+            CameraControl cameraControl;
+            std::unique_ptr<cluon::OD4Session> od4;
+            if (0 != commandlineArguments["cid"].size()) {
+                od4.reset(new cluon::OD4Session{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))});
+                od4->dataTrigger(opendlv::device::camera::ExposureRequest::ID(), [&cameraControl, ID](cluon::data::Envelope &&envelope) {
+                    if (ID == envelope.senderStamp()) {
+                        auto request = cluon::extractMessage<opendlv::device::camera::ExposureRequest>(std::move(envelope));
+                        cameraControl.requestExposure(request.automatic(), request.exposure());
+                    }
+                });
+                od4->dataTrigger(opendlv::device::camera::GainRequest::ID(), [&cameraControl, ID](cluon::data::Envelope &&envelope) {
+                    if (ID == envelope.senderStamp()) {
+                        auto request = cluon::extractMessage<opendlv::device::camera::GainRequest>(std::move(envelope));
+                        cameraControl.requestGain(request.gain());
+                    }
+                });
+                od4->dataTrigger(opendlv::device::camera::WhiteBalanceRequest::ID(), [&cameraControl, ID](cluon::data::Envelope &&envelope) {
+                    if (ID == envelope.senderStamp()) {
+                        auto request = cluon::extractMessage<opendlv::device::camera::WhiteBalanceRequest>(std::move(envelope));
+                        cameraControl.requestWhiteBalance(request.automatic(), request.temperature());
+                    }
+                });
+                od4->dataTrigger(opendlv::device::camera::FrameRateRequest::ID(), [&cameraControl, ID](cluon::data::Envelope &&envelope) {
+                    if (ID == envelope.senderStamp()) {
+                        auto request = cluon::extractMessage<opendlv::device::camera::FrameRateRequest>(std::move(envelope));
+                        cameraControl.requestFrameRate(request.frameRate());
+                    }
+                });
+                if (!od4->isRunning()) {
+                    std::cerr << "[opendlv-device-camera-opencv]: Failed to join OD4Session " << commandlineArguments["cid"] << "." << std::endl;
+                    return retCode;
+                }
+            }
+
+            // Compressed frames are encoded by a separate thread and sent via OD4.
+            std::unique_ptr<JpegEncoder> jpegEncoder;
+            if (od4 && (JPEG_FREQ > 0.0f)) {
+                jpegEncoder.reset(new JpegEncoder{*od4, ID, *sharedMemoryI420, LAYOUT_I420, JPEG_FREQ, JPEG_QUALITY});
+                std::clog << "[opendlv-device-camera-opencv]: Sending JPEG frames with quality " << JPEG_QUALITY << " at up to " << JPEG_FREQ << " Hz via OD4Session " << commandlineArguments["cid"] << " using " << JpegEncoder::backend() << "." << std::endl;
+            }
+
+            // The software auto-exposure starts from the camera's current settings and takes over
+            // manual control until exposure or gain are requested via OD4.
+            std::unique_ptr<AutoExposure> autoExposure;
+            if (AUTO_EXPOSURE) {
+                const float EXPOSURE{static_cast<float>(capture->get(cv::CAP_PROP_EXPOSURE))};
+                const float GAIN{static_cast<float>(capture->get(cv::CAP_PROP_GAIN))};
+                autoExposure.reset(new AutoExposure{AE_TARGET, AE_MAX_CLIPPED, (EXPOSURE > 0.0f) ? EXPOSURE : AE_MAX_EXPOSURE / 4.0f, 1.0f, AE_MAX_EXPOSURE, GAIN, 0.0f, AE_MAX_GAIN});
+                if (cameraControl.startAutoExposure()) {
+                    cameraControl.requestExposureByAutoExposure(autoExposure->exposure());
+                    std::clog << "[opendlv-device-camera-opencv]: Software auto-exposure targets a mean luma of " << AE_TARGET << " starting from exposure " << autoExposure->exposure() << " and gain " << autoExposure->gain() << "." << std::endl;
+                }
+                else {
+                    std::clog << "[opendlv-device-camera-opencv]: Software auto-exposure not started as exposure or gain were already requested via OD4." << std::endl;
+                }
+            }
+
+            std::thread captureThread([&capture, networkStream, &framePool, &cameraControl, FREQ, FRAME_DEADLINE, HAS_FRAME_DEADLINE, defaultFrameDeadline, RT_PRIORITY, &cpus]() {
+                applyRealtimeScheduling("capture thread", RT_PRIORITY, cpus);
+                // Re-open the camera with a backoff from 50 ms up to 2 s when it stops delivering frames.
+                CaptureSupervisor supervisor{*capture, std::chrono::milliseconds(FRAME_DEADLINE), std::chrono::milliseconds(50), std::chrono::milliseconds(2000)};
+                bool hasReportedReallocation{false};
+                auto nextReport{std::chrono::steady_clock::now() + std::chrono::seconds(10)};
+                while (!cluon::TerminateHandler::instance().isTerminated.load()) {
+                    if ( (nullptr != networkStream) && (std::chrono::steady_clock::now() > nextReport) ) {
+                        std::clog << "[opendlv-device-camera-opencv]: Stream latency above minimum: mean = " << networkStream->streamLatency().mean() << " ms, max = " << networkStream->streamLatency().max() << " ms; " << networkStream->drainedFrames() << " queued frames skipped so far." << std::endl;
+                        networkStream->streamLatency().reset();
+                        nextReport += std::chrono::seconds(10);
+                    }
+                    if (cameraControl.hasPendingRequests()) {
+                        cameraControl.apply(*capture);
+                        if (!HAS_FRAME_DEADLINE) {
+                            supervisor.setDeadline(std::chrono::milliseconds(defaultFrameDeadline(cameraControl.frameRate(FREQ))));
+                        }
+                    }
+                    Frame *frame = framePool.acquire();
+                    bool discontinuity{false};
+                    if (supervisor.read(frame->image, discontinuity)) {
+                        frame->sampleTimeStamp = cluon::time::now();
+                        frame->captureTime = capture->captureTime();
+                        frame->discontinuity = discontinuity;
+                        if (discontinuity) {
+                            // A re-opened camera starts with its default settings.
+                            cameraControl.restore();
+                        }
+                        if (!hasReportedReallocation && !framePool.usesPreallocatedBuffer(*frame)) {
+                            std::cerr << "[opendlv-device-camera-opencv]: Camera delivers frames of " << frame->image.cols << "x" << frame->image.rows << " with type " << frame->image.type() << " instead of the preallocated format; these frames are dropped." << std::endl;
+                            hasReportedReallocation = true;
+                        }
+                        framePool.publish(frame);
+                    }
+                    else {
+                        framePool.release(frame);
+                    }
+                }
+            });
+            applyRealtimeScheduling("conversion thread", RT_PRIORITY, cpus);
+
+            cv::Mat ARGB;
+            cv::Mat gray;
+            if (GRAY) {
+                gray = cv::Mat(OUTPUT_HEIGHT, OUTPUT_WIDTH, CV_8UC1, sharedMemoryGray->data(), LAYOUT_GRAY.stride);
+            }
+            else {
+                ARGB = cv::Mat(OUTPUT_HEIGHT, OUTPUT_WIDTH, CV_8UC4, sharedMemoryARGB->data(), LAYOUT_ARGB.stride);
+            }
+
+            // Common geometries are converted by pipelines specialized at compile time.
+            std::unique_ptr<FramePipeline> pipeline{makeFramePipeline(orientation, LAYOUT_I420, LAYOUT_ARGB, GENERIC_PIPELINE)};
+            if (!GRAY) {
+                std::clog << "[opendlv-device-camera-opencv]: Converting frames with the " << pipeline->name() << " pipeline" << (colourCorrection ? " and colour correction" : "") << "." << std::endl;
+            }
+            std::clog << "[opendlv-device-camera-opencv]: Built for " << baselineInstructionSet() << "; using the " << lumaHistogramVariant() << " variant of the luma histogram." << std::endl;
+
+            // Unchanged frames are dropped before converting them; frames after a discontinuity are always published.
+            std::unique_ptr<MotionGate> motionGate;
+            if (MOTION_GATE) {
+                motionGate.reset(new MotionGate{WIDTH, HEIGHT, IS_YUYV422, MOTION_THRESHOLD, static_cast<int64_t>(1000.0f * 1000.0f / MOTION_KEEP_ALIVE)});
+            }
+
+            // Frames are denoised in place right after converting them, i.e., before any statistics.
+            std::unique_ptr<TemporalDenoiser> denoiser;
+            if (DENOISE) {
+                denoiser.reset(GRAY ? new TemporalDenoiser{LAYOUT_GRAY, DENOISE_STRENGTH, DENOISE_THRESHOLD} : new TemporalDenoiser{LAYOUT_I420, DENOISE_STRENGTH, DENOISE_THRESHOLD});
+            }
+
+            FrameConverter converter{*pipeline, IS_YUYV422, LAYOUT_I420, LAYOUT_ARGB, autoExposure || IMAGE_QUALITY, IMAGE_QUALITY, colourCorrection.get(), GRAY ? nullptr : denoiser.get()};
+            auto updateAutoExposure = [&autoExposure, &cameraControl, FREQ, HAS_AE_MAX_EXPOSURE, defaultAEMaxExposure](const LumaStatistics &statistics) {
+                if (!HAS_AE_MAX_EXPOSURE) {
+                    autoExposure->setMaxExposure(defaultAEMaxExposure(cameraControl.frameRate(FREQ)), cameraControl);
+                }
+                autoExposure->update(statistics, cameraControl);
+            };
+            FrameMetadata metadataGray;
+            setLayout(metadataGray, LAYOUT_GRAY);
+            uint64_t sequenceNumber{0};
+            uint32_t discontinuities{0};
+            LumaStatistics lumaStats;
             while (!cluon::TerminateHandler::instance().isTerminated.load()) {
-                cv::Mat frame;
-                if (capture.read(frame)) {
-                    cluon::data::TimeStamp ts{cluon::time::now()};
+                Frame *frame = framePool.take(std::chrono::milliseconds(100));
+                if (nullptr != frame) {
+                    cluon::data::TimeStamp ts{frame->sampleTimeStamp};
+                    if (motionGate && !motionGate->update(frame->image.data, cluon::time::toMicroseconds(ts), frame->discontinuity)) {
+                        framePool.release(frame);
+                        continue;
+                    }
+                    sequenceNumber++;
+                    discontinuities += frame->discontinuity ? 1 : 0;
+                    const uint32_t FLAGS{(frame->discontinuity ? FrameMetadata::FLAG_DISCONTINUITY : 0) | ((motionGate && motionGate->isKeepAlive()) ? FrameMetadata::FLAG_KEEP_ALIVE : 0)};
+
+                    if (GRAY) {
+                        setFrameMetadata(metadataGray, *frame, sequenceNumber, FLAGS, discontinuities);
+                        sharedMemoryGray->lock();
+                        sharedMemoryGray->setTimeStamp(ts);
+                        {
+                            orientation.convertToGray(frame->image.data, IS_YUYV422, reinterpret_cast<uint8_t*>(sharedMemoryGray->data()), LAYOUT_GRAY);
+                            if (denoiser) {
+                                if (frame->discontinuity) {
+                                    denoiser->reset();
+                                }
+                                denoiser->apply(reinterpret_cast<uint8_t*>(sharedMemoryGray->data()));
+                            }
+                            if (autoExposure || IMAGE_QUALITY) {
+                                lumaStats = lumaStatistics(reinterpret_cast<uint8_t*>(sharedMemoryGray->data()), LAYOUT_GRAY.stride, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+                                setLumaStatistics(metadataGray, lumaStats);
+                            }
+                            if (IMAGE_QUALITY) {
+                                setSharpness(metadataGray, laplacianSums(reinterpret_cast<uint8_t*>(sharedMemoryGray->data()), LAYOUT_GRAY.stride, OUTPUT_WIDTH, OUTPUT_HEIGHT));
+                            }
+                            if (VERBOSE) {
+                                cv::imshow(sharedMemoryGray->name(), gray);
+                                cv::waitKey(10); // Necessary to actually display the image.
+                            }
+                            metadataGray.publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                            writeFrameMetadata(sharedMemoryGray->data(), sharedMemoryGray->size(), metadataGray);
+                        }
+                        sharedMemoryGray->unlock();
+                        sharedMemoryGray->notifyAll();
+                        framePool.release(frame);
+                        if (autoExposure) {
+                            updateAutoExposure(lumaStats);
+                        }
+                        continue;
+                    }
+
+                    converter.setFrame(*frame, sequenceNumber, FLAGS, discontinuities);
                     sharedMemoryI420->lock();
                     sharedMemoryI420->setTimeStamp(ts);
                     {
-                        if (IS_YUYV422) {
-                            libyuv::YUY2ToI420(reinterpret_cast<uint8_t*>(frame.data), WIDTH * 2 /* 2*WIDTH for YUYV 422*/,
-                                               reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), WIDTH,
-                                               reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT)), WIDTH/2,
-                                               reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2))), WIDTH/2,
-                                               WIDTH, HEIGHT);
-                        }
-                        else {
-                            libyuv::RGB24ToI420(reinterpret_cast<uint8_t*>(frame.data), WIDTH * 3 /* 3*WIDTH for RGB24*/,
-                                                reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), WIDTH,
-                                                reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT)), WIDTH/2,
-                                                reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2))), WIDTH/2,
-                                                WIDTH, HEIGHT);
-                        }
+                        converter.convertToI420(*frame, reinterpret_cast<uint8_t*>(sharedMemoryI420->data()));
+                        converter.metadataI420().publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                        writeFrameMetadata(sharedMemoryI420->data(), sharedMemoryI420->size(), converter.metadataI420());
                     }
                     sharedMemoryI420->unlock();
+                    // Notify I420 consumers right away as the ARGB conversion only reads the I420 frame.
+                    sharedMemoryI420->notifyAll();
+                    if (recorder) {
+                        recorder->notify();
+                    }
+                    if (jpegEncoder) {
+                        jpegEncoder->notify(converter.metadataI420().sampleTimeStamp);
+                    }
+                    framePool.release(frame);
+                    if (autoExposure) {
+                        updateAutoExposure(converter.lumaStatistics());
+                    }
 
                     sharedMemoryARGB->lock();
                     sharedMemoryARGB->setTimeStamp(ts);
                     {
-                        libyuv::I420ToARGB(reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), WIDTH,
-                                           reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT)), WIDTH/2,
-                                           reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2))), WIDTH/2,
-                                           reinterpret_cast<uint8_t*>(sharedMemoryARGB->data()), WIDTH * 4, WIDTH, HEIGHT);
+                        converter.convertToARGB(reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), reinterpret_cast<uint8_t*>(sharedMemoryARGB->data()));
 
                         if (VERBOSE) {
                             cv::imshow(sharedMemoryARGB->name(), ARGB);
                             cv::waitKey(10); // Necessary to actually display the image.
                         }
+                        converter.metadataARGB().publishTimeStamp = cluon::time::toMicroseconds(cluon::time::now());
+                        writeFrameMetadata(sharedMemoryARGB->data(), sharedMemoryARGB->size(), converter.metadataARGB());
                     }
                     sharedMemoryARGB->unlock();
-
-                    sharedMemoryI420->notifyAll();
                     sharedMemoryARGB->notifyAll();
                 }
             }
+            captureThread.join();
+            if (motionGate) {
+                std::clog << "[opendlv-device-camera-opencv]: Published " << sequenceNumber << " frames; " << motionGate->skipped() << " unchanged frames were skipped." << std::endl;
+            }
+            if (recorder) {
+                std::clog << "[opendlv-device-camera-opencv]: Recorded " << recorder->recorded() << " frames to '" << RECORD << "'; " << recorder->dropped() << " frames were dropped." << std::endl;
+            }
+            if (jpegEncoder) {
+                std::clog << "[opendlv-device-camera-opencv]: Sent " << jpegEncoder->encoded() << " JPEG frames; " << jpegEncoder->dropped() << " frames were dropped as the encoder was busy and " << jpegEncoder->oversized() << " were too large for a UDP packet." << std::endl;
+            }
         }
 
-        capture.release();
+        capture->release();
         retCode = 0;
     }
     return retCode;
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIME_SCHEDULING_HPP
+#define REALTIME_SCHEDULING_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * This function parses a list of CPUs like "2,3" or "0-1,4".
+ *
+ * @return true if the list could be parsed.
+ */
+inline bool parseCpuList(const std::string &str, std::vector<uint32_t> &cpus) noexcept {
+    cpus.clear();
+    try {
+        std::size_t start{0};
+        while (start < str.size()) {
+            std::size_t end{str.find(',', start)};
+            if (std::string::npos == end) {
+                end = str.size();
+            }
+            const std::string entry{str.substr(start, end - start)};
+            const std::size_t dash{entry.find('-')};
+            const int32_t FIRST{std::stoi(entry.substr(0, dash))};
+            const int32_t LAST{(std::string::npos == dash) ? FIRST : std::stoi(entry.substr(dash + 1))};
+            if ( (FIRST < 0) || (LAST < FIRST) || (LAST >= CPU_SETSIZE) ) {
+                return false;
+            }
+            for (int32_t cpu{FIRST}; cpu <= LAST; cpu++) {
+                cpus.push_back(static_cast<uint32_t>(cpu));
+            }
+            start = end + 1;
+        }
+    }
+    catch (...) {
+        return false;
+    }
+    return !cpus.empty();
+}
+
+/**
+ * This function moves the calling thread to SCHED_FIFO with the given priority
+ * (0 to keep the current policy) and pins it to the given CPUs (empty to keep
+ * the current affinity).
+ *
+ * @return true if all requested settings could be applied.
+ */
+inline bool applyRealtimeScheduling(const std::string &threadName, int32_t priority, const std::vector<uint32_t> &cpus) noexcept {
+    bool retVal{true};
+    if (0 < priority) {
+        struct sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        const int RESULT{::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param)};
+        if (0 != RESULT) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to set SCHED_FIFO with priority " << priority << " for " << threadName << ": " << ::strerror(RESULT) << std::endl;
+            retVal = false;
+        }
+    }
+    if (!cpus.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (auto cpu : cpus) {
+            CPU_SET(cpu, &cpuSet);
+        }
+        const int RESULT{::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set_t), &cpuSet)};
+        if (0 != RESULT) {
+            std::cerr << "[opendlv-device-camera-opencv]: Failed to set CPU affinity for " << threadName << ": " << ::strerror(RESULT) << std::endl;
+            retVal = false;
+        }
+    }
+    return retVal;
+}
+
+/**
+ * This function locks all current and future pages of the process into RAM.
+ *
+ * @return true if the pages could be locked.
+ */
+inline bool lockMemory() noexcept {
+    if (0 != ::mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        std::cerr << "[opendlv-device-camera-opencv]: Failed to lock memory: " << ::strerror(errno) << " (" << errno << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * This function writes to every page of the given memory to avoid page faults later.
+ */
+inline void prefault(char *data, uint32_t size) noexcept {
+    if (nullptr != data) {
+        const long pageSize{::sysconf(_SC_PAGESIZE)};
+        const uint32_t STEP{static_cast<uint32_t>((0 < pageSize) ? pageSize : 4096)};
+        for (uint32_t i{0}; i < size; i += STEP) {
+            *reinterpret_cast<volatile char*>(data + i) = 0;
+        }
+    }
+}
+
+#endif
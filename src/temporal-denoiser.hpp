@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2018  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPORAL_DENOISER_HPP
+#define TEMPORAL_DENOISER_HPP
+
+#include "frame-layout.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// Weights of the current frame are 7 bit fixed-point numbers.
+constexpr uint32_t TEMPORAL_WEIGHT_BITS{7};
+constexpr int32_t TEMPORAL_WEIGHT_ONE{1 << TEMPORAL_WEIGHT_BITS};
+// The accumulator keeps 8 fractional bits per pixel in 16 bit so that the
+// weighted differences of small steps are not rounded away; blending rounds
+// the accumulator to 1/256 and only the published pixels to integers.
+constexpr uint32_t TEMPORAL_FRACTION_BITS{8};
+
+/**
+ * This function is the plain scalar reference for temporalBlend.
+ */
+inline void temporalBlendScalar(uint8_t *frame, uint16_t *accumulator, uint32_t size, int32_t weight) noexcept {
+    const uint32_t KEEP{static_cast<uint32_t>(TEMPORAL_WEIGHT_ONE - weight)};
+    const uint32_t WEIGHT{static_cast<uint32_t>(weight)};
+    for (uint32_t i{0}; i < size; i++) {
+        const uint32_t BLENDED{(accumulator[i] * KEEP + (static_cast<uint32_t>(frame[i]) << TEMPORAL_FRACTION_BITS) * WEIGHT + TEMPORAL_WEIGHT_ONE / 2) >> TEMPORAL_WEIGHT_BITS};
+        accumulator[i] = static_cast<uint16_t>(BLENDED);
+        frame[i] = static_cast<uint8_t>((BLENDED + (1 << (TEMPORAL_FRACTION_BITS - 1))) >> TEMPORAL_FRACTION_BITS);
+    }
+}
+
+/**
+ * This function blends size pixels of a frame with the accumulator as
+ * accumulator + weight * (frame - accumulator) in 32 bit lanes for 16 pixels
+ * at once with SSE2 or NEON, stores the result in the accumulator, and the
+ * result rounded to integers in the frame.
+ */
+inline void temporalBlend(uint8_t *frame, uint16_t *accumulator, uint32_t size, int32_t weight) noexcept {
+    uint32_t i{0};
+#if defined(__SSE2__)
+    const __m128i ZERO{_mm_setzero_si128()};
+    const __m128i KEEP{_mm_set1_epi16(static_cast<int16_t>(TEMPORAL_WEIGHT_ONE - weight))};
+    const __m128i WEIGHT{_mm_set1_epi16(static_cast<int16_t>(weight))};
+    const __m128i ROUNDING{_mm_set1_epi32(TEMPORAL_WEIGHT_ONE / 2)};
+    const __m128i OUTPUT_ROUNDING{_mm_set1_epi16(1 << (TEMPORAL_FRACTION_BITS - 1))};
+    // SSE2 packs 32 bit lanes only with signed saturation, so the unsigned 16 bit results are packed with an offset.
+    const __m128i OFFSET32{_mm_set1_epi32(32768)};
+    const __m128i OFFSET16{_mm_set1_epi16(-32768)};
+    auto blend = [&](__m128i f, __m128i a) {
+        // a * KEEP needs 23 bits; f * WEIGHT fits into 16 bits before it is shifted.
+        const __m128i LOW{_mm_mullo_epi16(a, KEEP)};
+        const __m128i HIGH{_mm_mulhi_epu16(a, KEEP)};
+        const __m128i FRAME{_mm_mullo_epi16(f, WEIGHT)};
+        auto half = [&](__m128i product, __m128i frameProduct) {
+            const __m128i SUM{_mm_add_epi32(_mm_add_epi32(product, _mm_slli_epi32(frameProduct, TEMPORAL_FRACTION_BITS)), ROUNDING)};
+            return _mm_sub_epi32(_mm_srli_epi32(SUM, TEMPORAL_WEIGHT_BITS), OFFSET32);
+        };
+        return _mm_add_epi16(_mm_packs_epi32(half(_mm_unpacklo_epi16(LOW, HIGH), _mm_unpacklo_epi16(FRAME, ZERO)),
+                                             half(_mm_unpackhi_epi16(LOW, HIGH), _mm_unpackhi_epi16(FRAME, ZERO))), OFFSET16);
+    };
+    for (; i + 16 <= size; i += 16) {
+        const __m128i F{_mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i))};
+        const __m128i A0{blend(_mm_unpacklo_epi8(F, ZERO), _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i)))};
+        const __m128i A1{blend(_mm_unpackhi_epi8(F, ZERO), _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i + 8)))};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator + i), A0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator + i + 8), A1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(frame + i), _mm_packus_epi16(_mm_srli_epi16(_mm_adds_epu16(A0, OUTPUT_ROUNDING), TEMPORAL_FRACTION_BITS),
+                                                                                 _mm_srli_epi16(_mm_adds_epu16(A1, OUTPUT_ROUNDING), TEMPORAL_FRACTION_BITS)));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint16x4_t KEEP{vdup_n_u16(static_cast<uint16_t>(TEMPORAL_WEIGHT_ONE - weight))};
+    const uint16x4_t WEIGHT{vdup_n_u16(static_cast<uint16_t>(weight))};
+    auto blend = [&KEEP, &WEIGHT](uint8x8_t f, uint16x8_t a) {
+        const uint16x8_t FRAME{vshll_n_u8(f, TEMPORAL_FRACTION_BITS)};
+        const uint32x4_t LOW{vmlal_u16(vmull_u16(vget_low_u16(a), KEEP), vget_low_u16(FRAME), WEIGHT)};
+        const uint32x4_t HIGH{vmlal_u16(vmull_u16(vget_high_u16(a), KEEP), vget_high_u16(FRAME), WEIGHT)};
+        return vcombine_u16(vrshrn_n_u32(LOW, TEMPORAL_WEIGHT_BITS), vrshrn_n_u32(HIGH, TEMPORAL_WEIGHT_BITS));
+    };
+    for (; i + 16 <= size; i += 16) {
+        const uint8x16_t F{vld1q_u8(frame + i)};
+        const uint16x8_t A0{blend(vget_low_u8(F), vld1q_u16(accumulator + i))};
+        const uint16x8_t A1{blend(vget_high_u8(F), vld1q_u16(accumulator + i + 8))};
+        vst1q_u16(accumulator + i, A0);
+        vst1q_u16(accumulator + i + 8, A1);
+        vst1q_u8(frame + i, vcombine_u8(vrshrn_n_u16(A0, TEMPORAL_FRACTION_BITS), vrshrn_n_u16(A1, TEMPORAL_FRACTION_BITS)));
+    }
+#endif
+    temporalBlendScalar(frame + i, accumulator + i, size - i, weight);
+}
+
+/**
+ * This function sums the absolute differences between size pixels of a frame
+ * and the accumulator rounded to integers for 16 pixels at once with SSE2
+ * (psadbw) or NEON (vabd and pairwise adds).
+ *
+ * @return Sum of absolute differences.
+ */
+inline uint32_t temporalDifference(const uint8_t *frame, const uint16_t *accumulator, uint32_t size) noexcept {
+    uint32_t sum{0};
+    uint32_t i{0};
+#if defined(__SSE2__)
+    const __m128i OUTPUT_ROUNDING{_mm_set1_epi16(1 << (TEMPORAL_FRACTION_BITS - 1))};
+    __m128i sums{_mm_setzero_si128()};
+    for (; i + 16 <= size; i += 16) {
+        const __m128i A0{_mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i)), OUTPUT_ROUNDING), TEMPORAL_FRACTION_BITS)};
+        const __m128i A1{_mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i + 8)), OUTPUT_ROUNDING), TEMPORAL_FRACTION_BITS)};
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i)), _mm_packus_epi16(A0, A1)));
+    }
+    sum = static_cast<uint32_t>(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t sums{vdupq_n_u32(0)};
+    for (; i + 16 <= size; i += 16) {
+        const uint8x16_t A{vcombine_u8(vrshrn_n_u16(vld1q_u16(accumulator + i), TEMPORAL_FRACTION_BITS), vrshrn_n_u16(vld1q_u16(accumulator + i + 8), TEMPORAL_FRACTION_BITS))};
+        sums = vpadalq_u16(sums, vpaddlq_u8(vabdq_u8(vld1q_u8(frame + i), A)));
+    }
+    sum = vgetq_lane_u32(sums, 0) + vgetq_lane_u32(sums, 1) + vgetq_lane_u32(sums, 2) + vgetq_lane_u32(sums, 3);
+#endif
+    for (; i < size; i++) {
+        const int32_t ACCUMULATOR{static_cast<int32_t>((accumulator[i] + (1 << (TEMPORAL_FRACTION_BITS - 1))) >> TEMPORAL_FRACTION_BITS)};
+        sum += static_cast<uint32_t>(std::abs(static_cast<int32_t>(frame[i]) - ACCUMULATOR));
+    }
+    return sum;
+}
+
+/**
+ * TemporalDenoiser reduces sensor noise of static scenes by blending each
+ * frame with a running accumulator of the previously published frames, i.e.,
+ * a recursive (exponential) filter per pixel. Frames are filtered in place in
+ * the shared memory area right after converting them.
+ *
+ * To avoid ghosting, the filter falls back per block of 16x16 luma pixels
+ * (and the 8x8 chroma pixels covering the same area): if the mean absolute
+ * difference between the frame and the accumulator in the block's Y plane
+ * exceeds the threshold, the block is taken from the current frame unfiltered
+ * and restarts the accumulator there. Both passes read each plane once with
+ * SIMD so that the cost per frame is bounded and independent of the scene.
+ */
+class TemporalDenoiser {
+   private:
+    TemporalDenoiser(const TemporalDenoiser &) = delete;
+    TemporalDenoiser(TemporalDenoiser &&)      = delete;
+    TemporalDenoiser &operator=(const TemporalDenoiser &) = delete;
+    TemporalDenoiser &operator=(TemporalDenoiser &&) = delete;
+
+    static constexpr uint32_t BLOCK_SIZE{16};
+
+    struct Plane {
+        uint32_t offset;
+        uint32_t stride;
+        uint32_t width;
+        uint32_t height;
+        uint32_t blockSize;
+    };
+
+   public:
+    /**
+     * Constructor for I420 frames.
+     *
+     * @param layout Layout of the frames.
+     * @param strength Weight of the accumulator between 0 (no filtering) and 1.
+     * @param threshold Mean absolute luma difference of a block above which it counts as moving.
+     */
+    TemporalDenoiser(const I420Layout &layout, float strength, float threshold) noexcept
+        : TemporalDenoiser(layout.size, layout.width, layout.height, strength, threshold) {
+        m_planes.push_back(Plane{layout.offsetY, layout.strideY, layout.width, layout.height, BLOCK_SIZE});
+        m_planes.push_back(Plane{layout.offsetU, layout.strideU, chromaWidth(layout.width), chromaHeight(layout.height), BLOCK_SIZE / 2});
+        m_planes.push_back(Plane{layout.offsetV, layout.strideV, chromaWidth(layout.width), chromaHeight(layout.height), BLOCK_SIZE / 2});
+    }
+
+    /**
+     * Constructor for grayscale frames.
+     *
+     * @param layout Layout of the frames.
+     * @param strength Weight of the accumulator between 0 (no filtering) and 1.
+     * @param threshold Mean absolute luma difference of a block above which it counts as moving.
+     */
+    TemporalDenoiser(const GrayLayout &layout, float strength, float threshold) noexcept
+        : TemporalDenoiser(layout.size, layout.width, layout.height, strength, threshold) {
+        m_planes.push_back(Plane{0, layout.stride, layout.width, layout.height, BLOCK_SIZE});
+    }
+
+    /**
+     * This method restarts the filter with the next frame, e.g., after a discontinuity.
+     */
+    void reset() noexcept {
+        m_hasAccumulator = false;
+    }
+
+    /**
+     * This method filters the given frame in place.
+     */
+    void apply(uint8_t *frame) noexcept {
+        if (!m_hasAccumulator) {
+            restart(frame, m_accumulator.data(), static_cast<uint32_t>(m_accumulator.size()));
+            m_hasAccumulator = true;
+            m_movingBlocks = static_cast<uint32_t>(m_isMoving.size());
+            return;
+        }
+
+        // Motion is decided on the Y plane for all planes.
+        const Plane &Y{m_planes.front()};
+        m_movingBlocks = 0;
+        for (uint32_t by{0}; by < m_blocksPerColumn; by++) {
+            for (uint32_t bx{0}; bx < m_blocksPerRow; bx++) {
+                const uint32_t X{bx * BLOCK_SIZE};
+                const uint32_t WIDTH{std::min(uint32_t{BLOCK_SIZE}, Y.width - X)};
+                const uint32_t ROWS{std::min(uint32_t{BLOCK_SIZE}, Y.height - by * BLOCK_SIZE)};
+                uint32_t sad{0};
+                for (uint32_t r{0}; r < ROWS; r++) {
+                    const std::size_t OFFSET{Y.offset + static_cast<std::size_t>(by * BLOCK_SIZE + r) * Y.stride + X};
+                    sad += temporalDifference(frame + OFFSET, m_accumulator.data() + OFFSET, WIDTH);
+                }
+                const bool IS_MOVING{sad > static_cast<uint32_t>(m_threshold * static_cast<float>(WIDTH * ROWS))};
+                m_isMoving[by * m_blocksPerRow + bx] = IS_MOVING ? 1 : 0;
+                m_movingBlocks += IS_MOVING ? 1 : 0;
+            }
+        }
+
+        // Runs of static blocks are blended at once; moving blocks restart the accumulator.
+        for (const Plane &plane : m_planes) {
+            for (uint32_t y{0}; y < plane.height; y++) {
+                const uint8_t *isMoving{&m_isMoving[(y / plane.blockSize) * m_blocksPerRow]};
+                uint8_t *row{frame + plane.offset + static_cast<std::size_t>(y) * plane.stride};
+                uint16_t *accumulator{m_accumulator.data() + plane.offset + static_cast<std::size_t>(y) * plane.stride};
+                uint32_t bx{0};
+                while (bx < m_blocksPerRow) {
+                    uint32_t end{bx + 1};
+                    while ( (end < m_blocksPerRow) && (isMoving[end] == isMoving[bx]) ) {
+                        end++;
+                    }
+                    const uint32_t BEGIN{bx * plane.blockSize};
+                    const uint32_t SIZE{std::min(end * plane.blockSize, plane.width) - BEGIN};
+                    if (0 != isMoving[bx]) {
+                        restart(row + BEGIN, accumulator + BEGIN, SIZE);
+                    }
+                    else {
+                        temporalBlend(row + BEGIN, accumulator + BEGIN, SIZE, m_weight);
+                    }
+                    bx = end;
+                }
+            }
+        }
+    }
+
+    /**
+     * @return Number of blocks of the last frame that were taken unfiltered.
+     */
+    uint32_t movingBlocks() const noexcept {
+        return m_movingBlocks;
+    }
+
+    /**
+     * @return Number of blocks per frame.
+     */
+    uint32_t blocks() const noexcept {
+        return static_cast<uint32_t>(m_isMoving.size());
+    }
+
+   private:
+    TemporalDenoiser(uint32_t size, uint32_t width, uint32_t height, float strength, float threshold) noexcept
+        : m_planes()
+        , m_weight(std::max(1, std::min(TEMPORAL_WEIGHT_ONE, static_cast<int32_t>((1.0f - strength) * static_cast<float>(TEMPORAL_WEIGHT_ONE) + 0.5f))))
+        , m_threshold(threshold)
+        , m_blocksPerRow((width + BLOCK_SIZE - 1) / BLOCK_SIZE)
+        , m_blocksPerColumn((height + BLOCK_SIZE - 1) / BLOCK_SIZE)
+        , m_accumulator(size)
+        , m_isMoving(m_blocksPerRow * m_blocksPerColumn, 0)
+        , m_hasAccumulator(false)
+        , m_movingBlocks(0) {}
+
+    static void restart(const uint8_t *frame, uint16_t *accumulator, uint32_t size) noexcept {
+        for (uint32_t i{0}; i < size; i++) {
+            accumulator[i] = static_cast<uint16_t>(frame[i] << TEMPORAL_FRACTION_BITS);
+        }
+    }
+
+   private:
+    std::vector<Plane> m_planes;
+    const int32_t m_weight;
+    const float m_threshold;
+    const uint32_t m_blocksPerRow;
+    const uint32_t m_blocksPerColumn;
+    std::vector<uint16_t> m_accumulator;
+    std::vector<uint8_t> m_isMoving;
+    bool m_hasAccumulator;
+    uint32_t m_movingBlocks;
+};
+
+#endif